@@ -11,7 +11,9 @@ PLUGIN_CLASS_NAME=GPhotoServicePlugin
 
 SOURCES += \
     gphotocamera.cpp \
+    gphotocameraconfig.cpp \
     gphotocameracapturedestinationcontrol.cpp \
+    gphotocamerachannel.cpp \
     gphotocameracontrol.cpp \
     gphotocamerafocuscontrol.cpp \
     gphotocameraimagecapturecontrol.cpp \
@@ -19,16 +21,29 @@ SOURCES += \
     gphotocamerasession.cpp \
     gphotocontroller.cpp \
     gphotoexposurecontrol.cpp \
+    gphotoexposurestatistics.cpp \
+    gphotofocusmeasure.cpp \
+    gphotofocussearch.cpp \
+    gphotoframeexporter.cpp \
+    gphotokernels.cpp \
     gphotomediaservice.cpp \
+    gphotomotiondetector.cpp \
+    gphotopreviewdecoder.cpp \
+    gphotopreviewworker.cpp \
     gphotoserviceplugin.cpp \
+    gphotovideobuffer.cpp \
+    gphotovideobufferpool.cpp \
     gphotovideoinputdevicecontrol.cpp \
     gphotovideoprobecontrol.cpp \
     gphotovideorenderercontrol.cpp \
+    gphotoviewfindersettingscontrol.cpp \
     gphotoworker.cpp
 
 HEADERS += \
     gphotocamera.h \
+    gphotocameraconfig.h \
     gphotocameracapturedestinationcontrol.h \
+    gphotocamerachannel.h \
     gphotocameracontrol.h \
     gphotocamerafocuscontrol.h \
     gphotocameraimagecapturecontrol.h \
@@ -36,15 +51,29 @@ HEADERS += \
     gphotocamerasession.h \
     gphotocontroller.h \
     gphotoexposurecontrol.h \
+    gphotoexposurestatistics.h \
+    gphotofocusmeasure.h \
+    gphotofocussearch.h \
+    gphotoframeexporter.h \
+    gphotoframering.h \
+    gphotokernels.h \
     gphotomediaservice.h \
+    gphotomotiondetector.h \
+    gphotopreviewdecoder.h \
+    gphotopreviewworker.h \
     gphotoserviceplugin.h \
+    gphotovideobuffer.h \
+    gphotovideobufferpool.h \
     gphotovideoinputdevicecontrol.h \
     gphotovideoprobecontrol.h \
     gphotovideorenderercontrol.h \
+    gphotoviewfindersettingscontrol.h \
     gphotoworker.h
 
 OTHER_FILES += gphoto.json
-LIBS += -lgphoto2
+LIBS += -lgphoto2 -ljpeg
+# shm_open() lives in librt before glibc 2.34
+linux: LIBS += -lrt
 
 target.path = $$[QT_INSTALL_PLUGINS]/mediaservice
 INSTALLS += target
@@ -1,17 +1,35 @@
+#include <cstring>
+
 #include <QCameraImageCapture>
-#include <QThread>
+#include <QCryptographicHash>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
 #include <QFileInfo>
+#include <QRegularExpression>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QThread>
 
 #include "gphotocamera.h"
+#include "gphotopreviewworker.h"
 
 namespace {
     constexpr auto capturingFailLimit = 10;
+    constexpr auto defaultOperationTimeout = 1000;
     constexpr auto cancelautofocusParameter = "cancelautofocus";
+    constexpr auto configSnapshotDirectory = "gphoto";
+    constexpr auto eventPumpInterval = 250;
+    constexpr auto eventPumpTimeout = 1;
+    constexpr auto maxEventsPerPump = 32;
+    constexpr auto maxPendingEvents = 64;
+    constexpr auto maxPendingPreviewFrames = 3;
+    constexpr auto previewQueueCapacity = 2;
+    constexpr auto revalidatedOptionsPerPump = 4;
     constexpr auto viewfinderParameter = "viewfinder";
     constexpr auto waitForEventTimeout = 10;
 }
 
-using CameraWidgetPtr = std::unique_ptr<CameraWidget, int (*)(CameraWidget*)>;
 using VoidPtr = std::unique_ptr<void, void (*)(void*)>;
 
 QDebug operator<<(QDebug dbg, const CameraWidgetType &t)
@@ -57,20 +75,41 @@ GPhotoCamera::GPhotoCamera(GPContext *context, const CameraAbilities &abilities,
     , m_portInfo(portInfo)
     , m_camera(nullptr, gp_camera_free)
     , m_file(nullptr, gp_file_free)
+    , m_previewThread(new QThread)
+    , m_previewWorker(new GPhotoPreviewWorker(index, previewQueueCapacity))
     , m_index(index)
+    , m_operationTimeout(defaultOperationTimeout)
 {
-    connect(this, &GPhotoCamera::previewCaptured, this, &GPhotoCamera::capturePreview, Qt::QueuedConnection);
+    // Frames are delivered right from the decode thread
+    m_previewWorker->moveToThread(m_previewThread.get());
+    connect(m_previewWorker.get(), &GPhotoPreviewWorker::frameDecoded, this, &GPhotoCamera::previewCaptured,
+            Qt::DirectConnection);
+    // Motion captures are taken right in this thread, without a round trip through the GUI thread
+    connect(m_previewWorker.get(), &GPhotoPreviewWorker::motionDetected, this, &GPhotoCamera::captureOnMotion,
+            Qt::QueuedConnection);
+    m_previewThread->start();
+
+    m_eventClock.start();
+
+    // Timer events are interleaved with the queued preview fetches in worker event loop
+    m_eventPumpTimer.setInterval(eventPumpInterval);
+    connect(&m_eventPumpTimer, &QTimer::timeout, this, &GPhotoCamera::pumpEvents);
 }
 
 void GPhotoCamera::setIndex(int index)
 {
-    if (m_index != index)
+    if (m_index != index) {
         m_index = index;
+        m_previewWorker->setIndex(index);
+    }
 }
 
 GPhotoCamera::~GPhotoCamera()
 {
     closeCamera();
+
+    m_previewThread->quit();
+    m_previewThread->wait();
 }
 
 void GPhotoCamera::setState(QCamera::State state)
@@ -116,14 +155,19 @@ void GPhotoCamera::capturePhoto(int id, const QString &fileName)
         return;
     }
 
+    auto mirrorPosition = m_mirrorPosition;
     setMirrorPosition(MirrorPosition::Down);
 
+    // Files reported before the trigger belong to something else, e.g. a capture on camera body
+    const auto triggerTime = m_eventClock.elapsed();
+
     // Capture the frame from camera
     // See https://github.com/gphoto/libgphoto2/issues/156 for RAW+JPEG fix
     auto ret = gp_camera_trigger_capture(m_camera.get(), m_context);
     if (ret < GP_OK) {
         qWarning() << "GPhoto: Failed to capture frame:" << ret;
         emit imageCaptureError(m_index, id, QCameraImageCapture::ResourceError, tr("Failed to capture frame"));
+        setMirrorPosition(mirrorPosition);
         return;
     }
 
@@ -131,7 +175,7 @@ void GPhotoCamera::capturePhoto(int id, const QString &fileName)
     auto done = false;
 
     do {
-        event = waitForNextEvent(1000); // todo: How long to wait for long exposures?
+        event = waitForNextEvent(1000, triggerTime); // todo: How long to wait for long exposures?
 
         if (GP_EVENT_FILE_ADDED == event.event) {
             // Download the file
@@ -176,36 +220,26 @@ void GPhotoCamera::capturePhoto(int id, const QString &fileName)
         }
     } while (!done);
 
-    setMirrorPosition(MirrorPosition::Up);
+    setMirrorPosition(mirrorPosition);
+    flushParameterChanges();
 }
 
 QVariant GPhotoCamera::parameter(const QString &name)
 {
-    CameraWidget *root = nullptr;
-    auto ret = gp_camera_get_config(m_camera.get(), &root, m_context);
-    if (ret < GP_OK) {
-        qWarning() << "GPhoto: Unable to get root option from gphoto while getting parameter" << qPrintable(name);
-        return QVariant();
-    }
-
-    CameraWidget *option = nullptr;
-    ret = gp_widget_get_child_by_name(root, qPrintable(name), &option);
-    if (ret < GP_OK) {
-        qWarning() << "GPhoto: Unable to get config widget from gphoto";
+    auto option = configWidget(name);
+    if (!option) {
+        qWarning() << "GPhoto: Unable to get config widget" << qPrintable(name) << "from gphoto";
         return QVariant();
     }
 
-    // Unique pointer will free memory on exit
-    auto optionPtr = CameraWidgetPtr(option, gp_widget_free);
-
     CameraWidgetType type;
-    ret = gp_widget_get_type(option, &type);
+    auto ret = gp_widget_get_type(option, &type);
     if (ret < GP_OK) {
         qWarning() << "GPhoto: Unable to get config widget type from gphoto";
         return QVariant();
     }
 
-    if (type == GP_WIDGET_RADIO) {
+    if (type == GP_WIDGET_RADIO || type == GP_WIDGET_MENU) {
         char *value;
         ret = gp_widget_get_value(option, &value);
         if (ret < GP_OK) {
@@ -225,39 +259,99 @@ QVariant GPhotoCamera::parameter(const QString &name)
         return value != 0;
     }
 
+    if (type == GP_WIDGET_RANGE) {
+        auto value = 0.0F;
+        ret = gp_widget_get_value(option, &value);
+        if (ret < GP_OK) {
+            qWarning() << "GPhoto: Unable to get value for option" << qPrintable(name) << "from gphoto";
+            return QVariant();
+        }
+        return double(value);
+    }
+
     qWarning() << "GPhoto: Options of type" << type << "are currently not supported";
     return QVariant();
 }
 
 bool GPhotoCamera::setParameter(const QString &name, const QVariant &value)
 {
-    CameraWidget *root = nullptr;
-    auto ret = gp_camera_get_config(m_camera.get(), &root, m_context);
-    if (ret < GP_OK) {
-        qWarning() << "GPhoto: Unable to get root option from gphoto while setting parameter" << qPrintable(name);
+    // Get widget pointer
+    auto option = configWidget(name);
+    if (!option) {
+        qWarning() << "GPhoto: Unable to get option" << qPrintable(name) << "from gphoto";
         return false;
     }
 
-    // Get widget pointer
-    CameraWidget *option = nullptr;
-    ret = gp_widget_get_child_by_name(root, qPrintable(name), &option);
+    if (!setWidgetValue(option, name, value))
+        return false;
+
+    if (!m_singleConfigSupported)
+        return commitConfig({name});
+
+    auto ret = gp_camera_set_single_config(m_camera.get(), qPrintable(name), option, m_context);
+    if (GP_ERROR_NOT_SUPPORTED == ret) {
+        qDebug() << "GPhoto: Single config access is not supported, falling back to config tree";
+        m_singleConfigSupported = false;
+        m_config.invalidate();
+        return setParameter(name, value);
+    }
+
+    ++m_configStatistics.singleWrites;
+
+    // Camera may adjust or reject written value, so reload it on next access
+    m_config.markStale(name);
+
     if (ret < GP_OK) {
-        qWarning() << "GPhoto: Unable to get option" << qPrintable(name) << "from gphoto";
+        qWarning() << "GPhoto: Failed to set" << name << "config to camera:" << ret;
         return false;
     }
 
-    // Unique pointer will free memory on exit
-    auto optionPtr = CameraWidgetPtr(option, gp_widget_free);
+    waitForOperationCompleted({name});
+    return true;
+}
 
+QVariantMap GPhotoCamera::setParameters(const QVariantMap &values)
+{
+    QVariantMap result;
+    QStringList changed;
+
+    if (!m_camera || (!m_config.isValid() && !loadConfig()))
+        return result;
+
+    // Change all widgets in cached tree first and send them to camera in a single round trip
+    for (auto it = values.cbegin(); it != values.cend(); ++it) {
+        auto option = m_config.treeWidget(it.key());
+        if (!option) {
+            qWarning() << "GPhoto: Unable to get option" << qPrintable(it.key()) << "from gphoto";
+            result.insert(it.key(), false);
+            continue;
+        }
+
+        auto ok = setWidgetValue(option, it.key(), it.value());
+        result.insert(it.key(), ok);
+        if (ok)
+            changed.append(it.key());
+    }
+
+    if (!changed.isEmpty() && !commitConfig(changed)) {
+        for (auto it = result.begin(); it != result.end(); ++it)
+            it.value() = false;
+    }
+
+    return result;
+}
+
+bool GPhotoCamera::setWidgetValue(CameraWidget *option, const QString &name, const QVariant &value)
+{
     // Get option type
     CameraWidgetType type;
-    ret = gp_widget_get_type(option, &type);
+    auto ret = gp_widget_get_type(option, &type);
     if (ret < GP_OK) {
         qWarning() << "GPhoto: Unable to get option type from gphoto";
         return false;
     }
 
-    if (type == GP_WIDGET_RADIO) {
+    if (type == GP_WIDGET_RADIO || type == GP_WIDGET_MENU) {
         if (value.type() == QVariant::String) {
             // String, need no conversion
             ret = gp_widget_set_value(option, qPrintable(value.toString()));
@@ -267,90 +361,29 @@ bool GPhotoCamera::setParameter(const QString &name, const QVariant &value)
                 return false;
             }
 
-            ret = gp_camera_set_config(m_camera.get(), root, m_context);
-
-            if (ret < GP_OK) {
-                qWarning() << "GPhoto: Failed to set config to camera";
-                return false;
-            }
-
-            waitForOperationCompleted();
             return true;
         }
 
-        if (value.type() == QVariant::Double) {
-            // Trying to find nearest possible value (with the distance of 0.1) and set it to property
+        if (value.type() == QVariant::Double || value.type() == QVariant::Int) {
+            // Trying to find nearest possible value (with the distance of 0.1) and set it to property.
+            // Little hacks for 'ISO' option: if the value is -1, we pick the first non-numeric value
+            auto isInt = (value.type() == QVariant::Int);
             auto v = value.toDouble();
 
-            auto count = gp_widget_count_choices(option);
-            for (auto i = 0; i < count; ++i) {
-                const char *choice = nullptr;
-                gp_widget_get_choice(option, i, &choice);
-
-                // We use a workaround for flawed russian i18n of gphoto2 strings
-                auto ok = false;
-                auto choiceValue = QString::fromLocal8Bit(choice).replace(',', '.').toDouble(&ok);
-                if (!ok) {
-                    qDebug() << "GPhoto: Failed to convert value" << choice << "to double";
-                    continue;
-                }
-
-                if (qAbs(choiceValue - v) < 0.1) {
-                    ret = gp_widget_set_value(option, choice);
-                    if (ret < GP_OK) {
-                        qWarning() << "GPhoto: Failed to set value" << choice << "to" << name << "option:" << ret;
-                        return false;
-                    }
-
-                    ret = gp_camera_set_config(m_camera.get(), root, m_context);
-                    if (ret < GP_OK) {
-                        qWarning() << "GPhoto: Failed to set config to camera";
-                        return false;
-                    }
-
-                    waitForOperationCompleted();
-                    return true;
-                }
+            const auto &choice = (isInt && -1 == value.toInt()) ? m_config.firstNonNumericChoice(name)
+                                                                : m_config.nearestChoice(name, v, isInt ? 0.5 : 0.1);
+            if (choice.isEmpty()) {
+                qWarning() << "GPhoto: Can't find value matching to" << value << "for option" << name;
+                return false;
             }
 
-            qWarning() << "GPhoto: Can't find value matching to" << v << "for option" << name;
-            return false;
-        }
-
-        if (value.type() == QVariant::Int) {
-            // Little hacks for 'ISO' option: if the value is -1, we pick the first non-integer value
-            // we found and set it as a parameter
-            auto v = value.toInt();
-
-
-            auto count = gp_widget_count_choices(option);
-            for (auto i = 0; i < count; ++i) {
-                const char *choice = nullptr;
-                gp_widget_get_choice(option, i, &choice);
-
-                auto ok = false;
-                auto choiceValue = QString::fromLocal8Bit(choice).toInt(&ok);
-
-                if ((ok && choiceValue == v) || (!ok && v == -1)) {
-                    ret = gp_widget_set_value(option, choice);
-                    if (ret < GP_OK) {
-                        qWarning() << "GPhoto: Failed to set value" << choice << "to" << name << "option:" << ret;
-                        return false;
-                    }
-
-                    ret = gp_camera_set_config(m_camera.get(), root, m_context);
-                    if (ret < GP_OK) {
-                        qWarning() << "GPhoto: Failed to set config to camera";
-                        return false;
-                    }
-
-                    waitForOperationCompleted();
-                    return true;
-                }
+            ret = gp_widget_set_value(option, qPrintable(choice));
+            if (ret < GP_OK) {
+                qWarning() << "GPhoto: Failed to set value" << choice << "to" << name << "option:" << ret;
+                return false;
             }
 
-            qWarning() << "GPhoto: Can't find value matching to" << v << "for option" << name;
-            return false;
+            return true;
         }
 
         qWarning() << "GPhoto: Failed to set value" << value << "to" << name << "option. Type" << value.type()
@@ -374,13 +407,26 @@ bool GPhotoCamera::setParameter(const QString &name, const QVariant &value)
             return false;
         }
 
-        ret = gp_camera_set_config(m_camera.get(), root, m_context);
+        return true;
+    }
+
+    if (type == GP_WIDGET_RANGE) {
+        if (!value.canConvert<float>()) {
+            qWarning() << "GPhoto: Failed to set value" << value << "to" << name << "option. Type" << value.type()
+                       << "is not supported";
+            return false;
+        }
+
+        // Drives like manualfocusdrive take relative steps, so out of range values are clamped
+        const auto &range = m_config.option(name);
+        auto v = qBound(range.minimum, value.toFloat(), range.maximum);
+
+        ret = gp_widget_set_value(option, &v);
         if (ret < GP_OK) {
-            qWarning() << "GPhoto: Failed to set config to camera";
+            qWarning() << "GPhoto: Failed to set value" << v << "to" << name << "option:" << ret;
             return false;
         }
 
-        waitForOperationCompleted();
         return true;
     }
 
@@ -390,100 +436,149 @@ bool GPhotoCamera::setParameter(const QString &name, const QVariant &value)
 
 QVariantList GPhotoCamera::parameterValues(const QString &name, QMetaType::Type valueType)
 {
-    CameraWidget *root = nullptr;
-    auto ret = gp_camera_get_config(m_camera.get(), &root, m_context);
-    if (ret < GP_OK) {
-        qWarning() << "GPhoto: Unable to get root option from gphoto while setting parameter" << qPrintable(name);
-        return {};
-    }
-
-    // Get widget pointer
-    CameraWidget *option = nullptr;
-    ret = gp_widget_get_child_by_name(root, qPrintable(name), &option);
-    if (ret < GP_OK) {
+    // Choices and ranges are served from the config schema, which may come from a snapshot
+    if ((!m_config.hasOption(name) || m_config.isStale(name)) && !configWidget(name)) {
         qWarning() << "GPhoto: Unable to get option" << qPrintable(name) << "from gphoto";
         return {};
     }
 
-    // Unique pointer will free memory on exit
-    auto optionPtr = CameraWidgetPtr(option, gp_widget_free);
-
-    // Get option type
-    CameraWidgetType type;
-    ret = gp_widget_get_type(option, &type);
-    if (ret < GP_OK) {
-        qWarning() << "GPhoto: Unable to get option type from gphoto";
-        return {};
-    }
+    const auto &option = m_config.option(name);
 
     QVariantList values;
 
-    if (GP_WIDGET_RANGE == type) {
-        auto min = 0.0F;
-        auto max = 0.0F;
-        auto step = 0.0F;
-
-        ret = gp_widget_get_range(option, &min, &max, &step);
-        if (ret < GP_OK) {
-            qWarning() << "GPhoto: Unable to get widget range from gphoto";
-            return {};
-        }
+    if (GP_WIDGET_RANGE == option.type) {
+        auto min = option.minimum;
 
         values.append(min);
 
-        while (min < max)
-            values.append(min += step);
-
-        values.append(max);
-    } else if (GP_WIDGET_RADIO == type) {
-        auto count = gp_widget_count_choices(option);
-        for (auto i = 0; i < count; ++i) {
-            const char *choice = nullptr;
-            gp_widget_get_choice(option, i, &choice);
-            const auto &str = QString::fromLocal8Bit(choice);
-
-            auto ok = false;
-            QVariant value;
-
-            switch (valueType) {
-            case QMetaType::Double:
-                // We use a workaround for flawed russian i18n of gphoto2 strings
-                value = QString(str).replace(',', '.').toDouble(&ok);
-                if (!ok) {
-                    qWarning() << "GPhoto: Failed to convert value" << choice << "to double";
-                    continue;
-                }
-                break;
-            case QMetaType::Int:
-                value = str.toInt(&ok);
-                if (!ok) {
-                    qWarning() << "GPhoto: Failed to convert value" << choice << "to int";
-                    continue;
-                }
-                break;
-            case QMetaType::QString:
-                value = str;
-                break;
-            default:
-                qWarning() << "GPhoto: Failed to convert unsupported value" << choice;
-                continue;
+        while (min < option.maximum)
+            values.append(min += option.step);
+
+        values.append(option.maximum);
+    } else if (GP_WIDGET_RADIO == option.type || GP_WIDGET_MENU == option.type) {
+        switch (valueType) {
+        case QMetaType::Double:
+            // Choices were already parsed and sorted when config was loaded
+            for (auto value : option.values)
+                values.append(value);
+            break;
+        case QMetaType::Int:
+            for (auto value : option.values) {
+                if (qFuzzyIsNull(value - qRound(value)))
+                    values.append(qRound(value));
             }
-
-            values.append(value);
+            break;
+        case QMetaType::QString:
+            for (const auto &choice : option.choices)
+                values.append(choice);
+            break;
+        default:
+            qWarning() << "GPhoto: Failed to convert values of" << name << "to unsupported type" << valueType;
+            break;
         }
     }
 
     return values;
 }
 
+void GPhotoCamera::refreshConfig()
+{
+    m_config.invalidate();
+
+    if (m_camera && !loadConfig())
+        qWarning() << "GPhoto: Unable to refresh camera config";
+}
+
+void GPhotoCamera::setOperationTimeout(int timeout)
+{
+    m_operationTimeout = timeout;
+}
+
+void GPhotoCamera::setPreviewSize(const QSize &size)
+{
+    m_previewWorker->setTargetSize(size);
+}
+
+void GPhotoCamera::setPreviewFormat(QVideoFrame::PixelFormat format)
+{
+    m_previewWorker->setFormat(format);
+}
+
+void GPhotoCamera::setPreviewCrop(const QRectF &region)
+{
+    m_previewWorker->setCrop(region);
+}
+
+void GPhotoCamera::setPreviewFrameRate(qreal frameRate)
+{
+    m_previewFrameRate = qMax(qreal(0), frameRate);
+}
+
+void GPhotoCamera::setPreviewStatisticsEnabled(bool enabled)
+{
+    m_previewWorker->setStatisticsEnabled(enabled);
+}
+
+void GPhotoCamera::setPreviewFocusMeasurement(const QRectF &region, int peakingThreshold)
+{
+    m_previewWorker->setFocusMeasurement(region, peakingThreshold);
+}
+
+void GPhotoCamera::setPreviewMotionDetection(const QVector<QRectF> &regions, int threshold, int cooldown)
+{
+    m_previewWorker->setMotionDetection(regions, threshold, cooldown);
+}
+
+void GPhotoCamera::previewConsumed(int count)
+{
+    m_previewWorker->framesConsumed(count);
+
+    if (m_previewPaused) {
+        m_previewPaused = false;
+        schedulePreview();
+    }
+}
+
+GPhotoCamera::ConfigStatistics GPhotoCamera::configStatistics() const
+{
+    return m_configStatistics;
+}
+
+void GPhotoCamera::captureOnMotion(int index, qint64 timestamp)
+{
+    Q_UNUSED(index)
+
+    // Motion found in frames queued before viewfinder stopped is stale
+    if (QCamera::ActiveStatus != m_status)
+        return;
+
+    // Motion captures have negative ids, so they never clash with ids given by the session
+    const auto id = --m_motionCaptureId;
+    emit motionCaptureTriggered(m_index, id, timestamp);
+    capturePhoto(id, QString());
+
+    // Live view frames after the capture differ from the ones before it
+    m_previewWorker->holdMotionDetection();
+}
+
 void GPhotoCamera::capturePreview()
 {
+    m_previewScheduled = false;
+
     if (m_status != QCamera::ActiveStatus)
         return;
 
+    // Consumer hasn't taken previous frames yet, fetching more would only pile them up
+    if (m_previewWorker->pendingFrames() >= maxPendingPreviewFrames) {
+        m_previewPaused = true;
+        return;
+    }
+
+    m_previewTimer.start();
     gp_file_clean(m_file.get());
 
     auto ret = gp_camera_capture_preview(m_camera.get(), m_file.get(), m_context);
+    auto timestamp = GPhotoPreviewWorker::clock();
     if (GP_OK == ret) {
         const char *data = nullptr;
         unsigned long int size = 0;
@@ -491,8 +586,9 @@ void GPhotoCamera::capturePreview()
         if (GP_OK == ret) {
             m_capturingFailCount = 0;
             if (!QThread::currentThread()->isInterruptionRequested()) {
-                auto image = QImage::fromData(QByteArray(data, int(size)));
-                emit previewCaptured(m_index, image);
+                // Decoding runs in its own thread, so the next fetch may start right away
+                m_previewWorker->enqueue(data, size, timestamp);
+                schedulePreview();
             }
             return;
         }
@@ -505,7 +601,25 @@ void GPhotoCamera::capturePreview()
         qWarning() << "GPhoto: Closing camera because of capturing fail";
         emit error(m_index, QCamera::CameraError, tr("Unable to capture frame"));
         closeCamera();
+        return;
     }
+
+    schedulePreview();
+}
+
+void GPhotoCamera::schedulePreview()
+{
+    if (m_previewScheduled || m_status != QCamera::ActiveStatus)
+        return;
+
+    m_previewScheduled = true;
+
+    // Frame rate is capped by delaying the next fetch for the rest of the frame interval
+    auto delay = 0;
+    if (0 < m_previewFrameRate && m_previewTimer.isValid())
+        delay = qMax(0, qRound(1000 / m_previewFrameRate) - int(m_previewTimer.elapsed()));
+
+    QTimer::singleShot(delay, Qt::PreciseTimer, this, &GPhotoCamera::capturePreview);
 }
 
 void GPhotoCamera::openCamera()
@@ -544,6 +658,26 @@ void GPhotoCamera::openCamera()
     m_camera = std::move(cameraPtr);
     m_capturingFailCount = 0;
 
+    m_configSnapshotPath = configSnapshotPath();
+
+    // A known camera starts with the saved config schema, which is checked against camera by the event pump.
+    // Otherwise fetch the whole config once, further parameter access is served from cache
+    m_configRevalidationPending = loadConfigSnapshot();
+    if (!m_configRevalidationPending) {
+        if (loadConfig())
+            saveConfigSnapshot();
+        else
+            qWarning() << "GPhoto: Unable to load camera config, will retry on first access";
+    }
+
+    detectSingleConfigSupport();
+    detectCapabilities();
+
+    if (m_configRevalidationPending)
+        m_revalidatedNames = m_config.names();
+
+    m_eventPumpTimer.start();
+
     setStatus(QCamera::LoadedStatus);
 }
 
@@ -558,6 +692,12 @@ void GPhotoCamera::closeCamera()
 
     setStatus(QCamera::UnloadingStatus);
 
+    m_eventPumpTimer.stop();
+    m_pendingEvents.clear();
+    m_config.invalidate();
+    m_configRevalidationPending = false;
+    m_revalidatedNames.clear();
+
     gp_file_clean(m_file.get());
     m_file.reset();
 
@@ -576,9 +716,12 @@ void GPhotoCamera::startViewFinder()
 
     setStatus(QCamera::StartingStatus);
     setMirrorPosition(MirrorPosition::Up);
+    m_previewWorker->clear();
+    m_previewPaused = false;
     setStatus(QCamera::ActiveStatus);
 
-    capturePreview();
+    // Fetch may be still scheduled if viewfinder was restarted quickly
+    schedulePreview();
 }
 
 void GPhotoCamera::stopViewFinder()
@@ -587,21 +730,286 @@ void GPhotoCamera::stopViewFinder()
         return;
 
     setStatus(QCamera::StoppingStatus);
+    m_previewWorker->clear();
     setMirrorPosition(MirrorPosition::Down);
     setStatus(QCamera::LoadedStatus);
 }
 
 void GPhotoCamera::setMirrorPosition(MirrorPosition pos)
 {
-    if (parameter(QLatin1String(cancelautofocusParameter)).isValid()) {
+    if (m_mirrorPosition == pos)
+        return;
+
+    if (m_cancelAutofocusSupported)
         setParameter(QLatin1String(cancelautofocusParameter), true);
-    }
 
-    if (parameter(QLatin1String(viewfinderParameter)).isValid()) {
+    if (m_viewfinderSupported) {
         auto up = (MirrorPosition::Up == pos);
-        if (!setParameter(QLatin1String(viewfinderParameter), up))
+        if (!setParameter(QLatin1String(viewfinderParameter), up)) {
             qWarning() << "GPhoto: Failed to flap" << (up ? "up" : "down") << "camera mirror";
+            return;
+        }
+    }
+
+    m_mirrorPosition = pos;
+}
+
+CameraWidget* GPhotoCamera::configWidget(const QString &name)
+{
+    if (!m_camera)
+        return nullptr;
+
+    if (!m_config.isStale(name)) {
+        if (auto option = m_config.widget(name))
+            return option;
+
+        // Option is missing in a loaded config tree
+        if (m_config.isValid())
+            return nullptr;
+    }
+
+    if (m_singleConfigSupported) {
+        CameraWidget *option = nullptr;
+        auto ret = gp_camera_get_single_config(m_camera.get(), qPrintable(name), &option, m_context);
+        if (GP_ERROR_NOT_SUPPORTED != ret) {
+            if (ret < GP_OK)
+                return nullptr;
+
+            ++m_configStatistics.singleReads;
+            m_config.replaceWidget(name, option);
+            return option;
+        }
+
+        qDebug() << "GPhoto: Single config access is not supported, falling back to config tree";
+        m_singleConfigSupported = false;
+    }
+
+    if (!loadConfig())
+        return nullptr;
+
+    return m_config.widget(name);
+}
+
+bool GPhotoCamera::loadConfig()
+{
+    ++m_configStatistics.treeReads;
+    return m_config.load(m_camera.get(), m_context);
+}
+
+void GPhotoCamera::detectSingleConfigSupport()
+{
+    m_singleConfigSupported = false;
+
+    const auto &names = m_config.names();
+    if (names.isEmpty())
+        return;
+
+    // Probe with any existing option, drivers without single config support report it right away
+    CameraWidget *option = nullptr;
+    auto ret = gp_camera_get_single_config(m_camera.get(), qPrintable(names.first()), &option, m_context);
+    if (ret >= GP_OK) {
+        gp_widget_free(option);
+        m_singleConfigSupported = true;
+    }
+}
+
+QString GPhotoCamera::configSnapshotPath()
+{
+    const auto &cacheLocation = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    if (cacheLocation.isEmpty())
+        return QString();
+
+    // Schema depends on camera model and firmware, serial number tells bodies of the same model apart
+    QString version;
+    QString serialNumber;
+
+    std::unique_ptr<CameraText> summary(new CameraText);
+    if (gp_camera_get_summary(m_camera.get(), summary.get(), m_context) >= GP_OK) {
+        static const QRegularExpression versionRe(QStringLiteral("^\\s*(?:Device )?Version:\\s*(.+)$"),
+                                                  QRegularExpression::MultilineOption);
+        static const QRegularExpression serialNumberRe(QStringLiteral("^\\s*Serial Number:\\s*(.+)$"),
+                                                       QRegularExpression::MultilineOption);
+
+        const auto &text = QString::fromLocal8Bit(summary->text);
+        version = versionRe.match(text).captured(1).trimmed();
+        serialNumber = serialNumberRe.match(text).captured(1).trimmed();
+    }
+
+    const auto &key = QByteArray(m_abilities.model) + '\n' + version.toUtf8() + '\n' + serialNumber.toUtf8();
+    const auto &hash = QCryptographicHash::hash(key, QCryptographicHash::Sha1);
+
+    return QDir(cacheLocation).filePath(QLatin1String(configSnapshotDirectory) + QLatin1Char('/')
+                                        + QString::fromLatin1(hash.toHex()));
+}
+
+bool GPhotoCamera::loadConfigSnapshot()
+{
+    m_configSnapshot.clear();
+
+    if (m_configSnapshotPath.isEmpty())
+        return false;
+
+    QFile file(m_configSnapshotPath);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    const auto &data = file.readAll();
+    if (!m_config.loadSnapshot(data)) {
+        qWarning() << "GPhoto: Unable to read config snapshot" << m_configSnapshotPath;
+        return false;
+    }
+
+    m_configSnapshot = data;
+    return true;
+}
+
+void GPhotoCamera::saveConfigSnapshot()
+{
+    if (m_configSnapshotPath.isEmpty())
+        return;
+
+    const auto &data = m_config.snapshot();
+    if (data == m_configSnapshot)
+        return;
+
+    QDir().mkpath(QFileInfo(m_configSnapshotPath).absolutePath());
+
+    QSaveFile file(m_configSnapshotPath);
+    if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size() || !file.commit()) {
+        qWarning() << "GPhoto: Unable to write config snapshot" << m_configSnapshotPath;
+        return;
+    }
+
+    m_configSnapshot = data;
+}
+
+void GPhotoCamera::revalidateConfig()
+{
+    if (!m_configRevalidationPending)
+        return;
+
+    // Config may be already fetched by a parameter access meanwhile
+    if (m_config.isSnapshot()) {
+        if (m_singleConfigSupported) {
+            // Options are checked a few at a time, preview fetches and parameter requests go in between
+            for (auto i = 0; i < revalidatedOptionsPerPump && !m_revalidatedNames.isEmpty(); ++i) {
+                const auto name = m_revalidatedNames.takeFirst();
+                if (!m_config.widget(name))
+                    configWidget(name);
+            }
+
+            if (!m_revalidatedNames.isEmpty() && m_config.isSnapshot())
+                return;
+        } else {
+            // Fetching the whole tree takes seconds on some cameras, it must not hold up live view
+            if (QCamera::ActiveStatus == m_status)
+                return;
+
+            if (!loadConfig()) {
+                qWarning() << "GPhoto: Unable to load camera config, will retry on first access";
+                m_configRevalidationPending = false;
+                return;
+            }
+        }
+    }
+
+    m_configRevalidationPending = false;
+    m_revalidatedNames.clear();
+
+    // Config written meanwhile is reloaded on next access, there is nothing to compare with
+    if (!m_config.isValid() && !m_config.isSnapshot())
+        return;
+
+    if (m_config.snapshot() == m_configSnapshot)
+        return;
+
+    saveConfigSnapshot();
+    emit parametersChanged(m_index, {});
+}
+
+void GPhotoCamera::detectCapabilities()
+{
+    // Schema is usually at hand already, either loaded or restored from snapshot
+    auto hasOption = [this] (const char *name) {
+        const auto &option = QLatin1String(name);
+        return m_config.hasOption(option)
+                || (!m_config.isValid() && !m_config.isSnapshot() && configWidget(option));
+    };
+
+    m_cancelAutofocusSupported = hasOption(cancelautofocusParameter);
+    m_viewfinderSupported = hasOption(viewfinderParameter);
+
+    // Mirror is down when camera is opened
+    m_mirrorPosition = MirrorPosition::Down;
+}
+
+bool GPhotoCamera::commitConfig(const QStringList &names)
+{
+    ++m_configStatistics.treeWrites;
+    auto ret = gp_camera_set_config(m_camera.get(), m_config.root(), m_context);
+
+    // Camera may adjust or reject written values, so reload config on next access
+    m_config.invalidate();
+
+    if (ret < GP_OK) {
+        qWarning() << "GPhoto: Failed to set config to camera";
+        return false;
+    }
+
+    waitForOperationCompleted(names);
+    return true;
+}
+
+QString GPhotoCamera::handleUnknownEvent(const char *data)
+{
+    // PTP drivers report property changes as unknown events with a text description,
+    // newer libgphoto2 versions also put the option name there
+    if (!data || !strstr(data, "Property"))
+        return QString();
+
+    static const QRegularExpression re(QStringLiteral("PTP Property [0-9a-fA-F]+ changed, \"([^\"]+)\""));
+    const auto &match = re.match(QString::fromLocal8Bit(data));
+    if (match.hasMatch()) {
+        const auto &name = match.captured(1);
+        m_config.markStale(name);
+        m_changedParameters.insert(name);
+        return name;
+    }
+
+    m_config.invalidate();
+    m_allParametersChanged = true;
+    return QString();
+}
+
+void GPhotoCamera::flushParameterChanges()
+{
+    if (m_allParametersChanged) {
+        emit parametersChanged(m_index, QStringList());
+    } else if (!m_changedParameters.isEmpty()) {
+        emit parametersChanged(m_index, m_changedParameters.values());
+    }
+
+    m_changedParameters.clear();
+    m_allParametersChanged = false;
+}
+
+void GPhotoCamera::pumpEvents()
+{
+    if (!m_camera)
+        return;
+
+    for (auto i = 0; i < maxEventsPerPump && m_camera; ++i) {
+        CameraEvent event;
+        if (!readEvent(eventPumpTimeout, &event) || GP_EVENT_TIMEOUT == event.event)
+            break;
+
+        // Property changes are already applied to config cache, other events are kept for waitForNextEvent()
+        if (GP_EVENT_UNKNOWN != event.event)
+            queueEvent(event);
     }
+
+    revalidateConfig();
+    flushParameterChanges();
 }
 
 bool GPhotoCamera::isReadyForCapture() const
@@ -621,23 +1029,14 @@ void GPhotoCamera::openCameraErrorHandle(const QString &errorText)
 
 void GPhotoCamera::logOption(const char *name)
 {
-    CameraWidget *root;
-    auto ret = gp_camera_get_config(m_camera.get(), &root, m_context);
-    if (ret < GP_OK) {
-        qWarning() << "GPhoto: Unable to get root option from gphoto";
+    auto option = configWidget(QLatin1String(name));
+    if (!option) {
+        qWarning() << "GPhoto: Unable to get config widget from gphoto";
         return;
     }
 
-    CameraWidget *option;
-    ret = gp_widget_get_child_by_name(root, name, &option);
-    if (ret < GP_OK)
-        qWarning() << "GPhoto: Unable to get config widget from gphoto";
-
-    // Unique pointer will free memory on exit
-    auto optionPtr = CameraWidgetPtr(option, gp_widget_free);
-
     CameraWidgetType type;
-    ret = gp_widget_get_type(option, &type);
+    auto ret = gp_widget_get_type(option, &type);
     if (ret < GP_OK)
         qWarning() << "GPhoto: Unable to get config widget type from gphoto";
 
@@ -659,52 +1058,95 @@ void GPhotoCamera::logOption(const char *name)
     }
 }
 
-void GPhotoCamera::waitForOperationCompleted()
+void GPhotoCamera::waitForOperationCompleted(const QStringList &names)
 {
-    CameraEventType type;
-    auto ret = GP_OK;
-    do {
-        auto dataPtr = VoidPtr(nullptr, free);
-        auto data = dataPtr.get();
-        ret = gp_camera_wait_for_event(m_camera.get(), waitForEventTimeout, &type, &data, m_context);
-    } while ((ret == GP_OK) && (type != GP_EVENT_TIMEOUT) && m_camera);
+    QSet<QString> pendingNames(names.cbegin(), names.cend());
+
+    QElapsedTimer timer;
+    timer.start();
+
+    while (m_camera && !pendingNames.isEmpty() && timer.elapsed() < m_operationTimeout) {
+        CameraEvent event;
+        // Many writes are never reported, e.g. drive actions or unchanged values,
+        // so the first idle poll ends the wait and the timeout only bounds a busy camera
+        if (!readEvent(waitForEventTimeout, &event) || GP_EVENT_TIMEOUT == event.event)
+            break;
+
+        if (GP_EVENT_UNKNOWN == event.event) {
+            // Property changes are already applied to config cache,
+            // the operation is done as soon as camera reports all written options.
+            // Unnamed change may be any of them, so it completes the operation too
+            if (event.propertyName.isEmpty())
+                pendingNames.clear();
+            else
+                pendingNames.remove(event.propertyName);
+        } else {
+            // Keep other events for the rest of the system
+            queueEvent(event);
+        }
+    }
+
+    flushParameterChanges();
 }
 
+void GPhotoCamera::queueEvent(const CameraEvent &event)
+{
+    // Nobody may wait for events between captures, the oldest are dropped then
+    if (maxPendingEvents <= m_pendingEvents.size())
+        m_pendingEvents.removeFirst();
+
+    m_pendingEvents.append(event);
+}
 
-GPhotoCamera::CameraEvent GPhotoCamera::waitForNextEvent(int timeout)
+GPhotoCamera::CameraEvent GPhotoCamera::waitForNextEvent(int timeout, qint64 since)
 {
+    while (!m_pendingEvents.isEmpty()) {
+        const auto event = m_pendingEvents.takeFirst();
+        if (since <= event.timestamp)
+            return event;
+    }
+
     CameraEvent event;
-    auto dataPtr = VoidPtr(nullptr, free);
-    auto data = dataPtr.get();
+    readEvent(timeout, &event);
+    return event;
+}
+
+bool GPhotoCamera::readEvent(int timeout, CameraEvent *event)
+{
+    void *data = nullptr;
     CameraEventType eventType = GP_EVENT_UNKNOWN;
 
     auto ret = gp_camera_wait_for_event(m_camera.get(), timeout, &eventType, &data, m_context);
-    if (ret != GP_OK || GP_EVENT_UNKNOWN == eventType) {
+    // Unique pointer will free memory on exit
+    auto dataPtr = VoidPtr(data, free);
+    if (ret != GP_OK) {
         // according to implementation of gp_camera_wait_for_event();
         // if i dont get OK, no event type & data is updated.
-        return event;
+        return false;
     }
 
-    event.event = eventType;
+    event->event = eventType;
+    event->timestamp = m_eventClock.elapsed();
 
     if (data) {
         // if we have data, it depends on the event type whats inside...
         if (GP_EVENT_FILE_ADDED == eventType || GP_EVENT_FILE_CHANGED == eventType) {
             auto file = reinterpret_cast<CameraFilePath*>(data);
-            event.folderName = QString::fromLatin1(file->folder);
-            event.fileName = QString::fromLatin1(file->name);
+            event->folderName = QString::fromLatin1(file->folder);
+            event->fileName = QString::fromLatin1(file->name);
         } else if (GP_EVENT_FOLDER_ADDED == eventType) {
             auto folder= reinterpret_cast<CameraFilePath*>(data);
-            event.folderName = QString::fromLatin1(folder->folder);
+            event->folderName = QString::fromLatin1(folder->folder);
+        } else if (GP_EVENT_UNKNOWN == eventType) {
+            event->propertyName = handleUnknownEvent(static_cast<const char*>(data));
         }
     }
 
-//    qDebug() << "Got gphoto camera event:" << event.event << event.folderName << event.fileName;
+//    qDebug() << "Got gphoto camera event:" << event->event << event->folderName << event->fileName;
 
-    return event;
+    return true;
 }
 
-
 void GPhotoCamera::setStatus(QCamera::Status status)
 {
     if (m_status != status) {
@@ -4,16 +4,30 @@
 #include <memory>
 
 #include <QCamera>
+#include <QElapsedTimer>
 #include <QObject>
+#include <QRectF>
+#include <QSet>
+#include <QTimer>
+#include <QVector>
+#include <QVideoFrame>
 
 #include <gphoto2/gphoto2-abilities-list.h>
 #include <gphoto2/gphoto2-camera.h>
 #include <gphoto2/gphoto2-file.h>
 #include <gphoto2/gphoto2-port-info-list.h>
 
+#include "gphotocameraconfig.h"
+
 using CameraFilePtr = std::unique_ptr<CameraFile, int (*)(CameraFile*)>;
 using CameraPtr = std::unique_ptr<Camera, int (*)(Camera*)>;
 
+QT_BEGIN_NAMESPACE
+class QThread;
+QT_END_NAMESPACE
+
+class GPhotoPreviewWorker;
+
 class GPhotoCamera final : public QObject
 {
     Q_OBJECT
@@ -31,6 +45,18 @@ public:
         QString folderName;
         /// For some events we get a folder / file info
         QString fileName;
+        /// For property change events we may get the option name
+        QString propertyName;
+        /// When the event was read from camera, msecs of the camera event clock
+        qint64 timestamp = 0;
+    };
+
+    /// Counters of config access paths taken, see configWidget() and setParameter()
+    struct ConfigStatistics {
+        quint64 singleReads = 0;
+        quint64 singleWrites = 0;
+        quint64 treeReads = 0;
+        quint64 treeWrites = 0;
     };
 
     enum class MirrorPosition {
@@ -52,26 +78,55 @@ public:
 
     QVariant parameter(const QString &name);
     bool setParameter(const QString &name, const QVariant &value);
+    QVariantMap setParameters(const QVariantMap &values);
     QVariantList parameterValues(const QString &name, QMetaType::Type valueType);
+    void refreshConfig();
+    void setOperationTimeout(int timeout);
+    void setPreviewSize(const QSize &size);
+    void setPreviewFormat(QVideoFrame::PixelFormat format);
+    void setPreviewCrop(const QRectF &region);
+    void setPreviewFrameRate(qreal frameRate);
+    void setPreviewStatisticsEnabled(bool enabled);
+    void setPreviewFocusMeasurement(const QRectF &region, int peakingThreshold);
+    void setPreviewMotionDetection(const QVector<QRectF> &regions, int threshold, int cooldown);
+    void previewConsumed(int count);
+    ConfigStatistics configStatistics() const;
 
 signals:
     void captureModeChanged(int index, QCamera::CaptureModes captureMode);
     void error(int index, int errorCode, const QString &errorString);
     void imageCaptured(int index, int id, const QByteArray &imageData, const QString &format, const QString &fileName);
     void imageCaptureError(int index, int id, int errorCode, const QString &errorString);
-    void previewCaptured(int index, const QImage &image);
+    void motionCaptureTriggered(int index, int id, qint64 timestamp);
+    void parametersChanged(int index, const QStringList &names);
+    void previewCaptured(int index, const QVideoFrame &frame);
     void readyForCaptureChanged(int index, bool readyForCapture);
     void stateChanged(int index, QCamera::State state);
     void statusChanged(int index, QCamera::Status status);
 
 private slots:
+    void captureOnMotion(int index, qint64 timestamp);
     void capturePreview();
+    void pumpEvents();
 
 private:
     Q_DISABLE_COPY(GPhotoCamera)
 
+    void schedulePreview();
     void openCamera();
     void closeCamera();
+    CameraWidget* configWidget(const QString &name);
+    bool loadConfig();
+    void detectSingleConfigSupport();
+    void detectCapabilities();
+    QString configSnapshotPath();
+    bool loadConfigSnapshot();
+    void saveConfigSnapshot();
+    void revalidateConfig();
+    bool setWidgetValue(CameraWidget *option, const QString &name, const QVariant &value);
+    bool commitConfig(const QStringList &names);
+    QString handleUnknownEvent(const char *data);
+    void flushParameterChanges();
     void startViewFinder();
     void stopViewFinder();
     void setMirrorPosition(MirrorPosition pos);
@@ -79,14 +134,30 @@ private:
     void logOption(const char *name);
     void openCameraErrorHandle(const QString &errorText);
     void setStatus(QCamera::Status status);
-    void waitForOperationCompleted();
+
+    /** Drains camera events after a config write.
+     *
+     * Returns as soon as camera has no more events, reports changes of all
+     * written options or reports an unnamed change, or when operation
+     * timeout expires.
+     * Events not related to the operation are kept for waitForNextEvent().
+     *
+     * @param names written options
+     */
+    void waitForOperationCompleted(const QStringList &names);
+
+    void queueEvent(const CameraEvent &event);
 
     /** Waits for the next event to arrive and deliver event data.
+     *
+     * Kept events read before since are skipped.
      *
      * @param wait_msec max time to wait in msecs
+     * @param since event clock time in msecs
      * @return the event which occured.
      */
-    CameraEvent waitForNextEvent(int timeout);
+    CameraEvent waitForNextEvent(int timeout, qint64 since);
+    bool readEvent(int timeout, CameraEvent *event);
 
 
     GPContext *const m_context;
@@ -94,11 +165,34 @@ private:
     GPPortInfo m_portInfo;
     CameraPtr m_camera;
     CameraFilePtr m_file;
+    std::unique_ptr<QThread> m_previewThread;
+    std::unique_ptr<GPhotoPreviewWorker> m_previewWorker;
+    QElapsedTimer m_previewTimer;
+    qreal m_previewFrameRate = 0;
+    bool m_previewScheduled = false;
+    bool m_previewPaused = false;
+    GPhotoCameraConfig m_config;
+    QString m_configSnapshotPath;
+    QByteArray m_configSnapshot;
+    QStringList m_revalidatedNames;
+    bool m_configRevalidationPending = false;
+    ConfigStatistics m_configStatistics;
+    QTimer m_eventPumpTimer;
+    QSet<QString> m_changedParameters;
+    QList<CameraEvent> m_pendingEvents;
+    QElapsedTimer m_eventClock;
+    bool m_allParametersChanged = false;
     QCamera::State m_state = QCamera::UnloadedState;
     QCamera::Status m_status = QCamera::UnloadedStatus;
     QCamera::CaptureModes m_captureMode = QCamera::CaptureStillImage;
     int m_capturingFailCount = 0;
+    int m_motionCaptureId = 0;
     int m_index = 0;
+    int m_operationTimeout;
+    bool m_singleConfigSupported = false;
+    bool m_cancelAutofocusSupported = false;
+    bool m_viewfinderSupported = false;
+    MirrorPosition m_mirrorPosition = MirrorPosition::Down;
 };
 
 #endif // GPHOTOCAMERA_H
@@ -0,0 +1,6 @@
+#include "gphotocamerachannel.h"
+
+GPhotoCameraChannel::GPhotoCameraChannel(QObject *parent)
+    : QObject(parent)
+{
+}
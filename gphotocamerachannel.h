@@ -0,0 +1,41 @@
+#ifndef GPHOTOCAMERACHANNEL_H
+#define GPHOTOCAMERACHANNEL_H
+
+#include <QCamera>
+#include <QObject>
+#include <QVideoFrame>
+
+/** Notifications of a single camera.
+ *
+ * Controller routes every worker signal to the channel of its camera
+ * index, so a session bound to one camera isn't woken up by frames and
+ * events of the others. Signals keep the camera index argument, so slots
+ * may be shared with code which still listens to several cameras.
+ */
+class GPhotoCameraChannel final : public QObject
+{
+    Q_OBJECT
+public:
+    explicit GPhotoCameraChannel(QObject *parent = nullptr);
+
+    GPhotoCameraChannel(GPhotoCameraChannel&&) = delete;
+    GPhotoCameraChannel& operator=(GPhotoCameraChannel&&) = delete;
+
+signals:
+    void captureModeChanged(int cameraIndex, QCamera::CaptureModes);
+    void error(int cameraIndex, int errorCode, const QString &errorString);
+    void imageCaptured(int cameraIndex, int id, const QByteArray &imageData,
+                       const QString &format, const QString &fileName);
+    void imageCaptureError(int cameraIndex, int id, int errorCode, const QString &errorString);
+    void motionCaptureTriggered(int cameraIndex, int id, qint64 timestamp);
+    void parametersChanged(int cameraIndex, const QStringList &names);
+    void previewCaptured(int cameraIndex, const QVideoFrame &frame);
+    void readyForCaptureChanged(int cameraIndex, bool);
+    void stateChanged(int cameraIndex, QCamera::State);
+    void statusChanged(int cameraIndex, QCamera::Status);
+
+private:
+    Q_DISABLE_COPY(GPhotoCameraChannel)
+};
+
+#endif // GPHOTOCAMERACHANNEL_H
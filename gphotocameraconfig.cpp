@@ -0,0 +1,317 @@
+#include <algorithm>
+#include <numeric>
+
+#include <QDataStream>
+#include <QDebug>
+
+#include "gphotocameraconfig.h"
+
+namespace {
+    constexpr quint32 snapshotMagic = 0x47504353; // "GPCS"
+    constexpr quint16 snapshotVersion = 1;
+
+    QString rootPath(CameraWidget *root)
+    {
+        const char *name = nullptr;
+        if (gp_widget_get_name(root, &name) < GP_OK || !name)
+            return QString();
+
+        return QLatin1Char('/') + QString::fromLatin1(name);
+    }
+
+    void parseChoices(GPhotoCameraConfig::Option *option)
+    {
+        QVector<double> values;
+        QVector<int> indexes;
+
+        for (auto i = 0; i < option->choices.size(); ++i) {
+            auto value = 0.0;
+            if (GPhotoCameraConfig::parseChoice(option->choices.at(i), &value)) {
+                values.append(value);
+                indexes.append(i);
+            } else if (option->firstNonNumeric < 0) {
+                option->firstNonNumeric = i;
+            }
+        }
+
+        // Sort values keeping the choice order for equal ones
+        QVector<int> order(values.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&values] (int a, int b) {
+            return values.at(a) < values.at(b);
+        });
+
+        option->values.reserve(order.size());
+        option->indexes.reserve(order.size());
+        for (auto i : order) {
+            option->values.append(values.at(i));
+            option->indexes.append(indexes.at(i));
+        }
+    }
+}
+
+GPhotoCameraConfig::GPhotoCameraConfig()
+    : m_root(nullptr, gp_widget_free)
+{
+}
+
+GPhotoCameraConfig::~GPhotoCameraConfig() = default;
+
+bool GPhotoCameraConfig::isValid() const
+{
+    return bool(m_root);
+}
+
+bool GPhotoCameraConfig::isSnapshot() const
+{
+    return m_snapshot;
+}
+
+bool GPhotoCameraConfig::load(Camera *camera, GPContext *context)
+{
+    invalidate();
+
+    CameraWidget *root = nullptr;
+    auto ret = gp_camera_get_config(camera, &root, context);
+    if (ret < GP_OK) {
+        qWarning() << "GPhoto: Unable to get root option from gphoto:" << ret;
+        return false;
+    }
+
+    // Freeing the root widget frees the whole tree
+    m_root.reset(root);
+
+    const auto &path = rootPath(root);
+    auto count = gp_widget_count_children(root);
+    for (auto i = 0; i < count; ++i) {
+        CameraWidget *child = nullptr;
+        if (gp_widget_get_child(root, i, &child) >= GP_OK)
+            indexWidget(child, path);
+    }
+
+    return true;
+}
+
+void GPhotoCameraConfig::invalidate()
+{
+    m_snapshot = false;
+    m_staleNames.clear();
+    m_replacements.clear();
+    m_options.clear();
+    m_index.clear();
+    m_root.reset();
+}
+
+QByteArray GPhotoCameraConfig::snapshot() const
+{
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_6);
+
+    // Keys are sorted, so equal schemas give equal snapshots
+    const auto &optionNames = names();
+
+    stream << snapshotMagic << snapshotVersion << quint32(optionNames.size());
+    for (const auto &name : optionNames) {
+        const auto &option = m_options[name];
+        stream << name << qint32(option.type) << option.choices << option.minimum << option.maximum << option.step;
+    }
+
+    return data;
+}
+
+bool GPhotoCameraConfig::loadSnapshot(const QByteArray &data)
+{
+    invalidate();
+
+    QDataStream stream(data);
+    stream.setVersion(QDataStream::Qt_5_6);
+
+    quint32 magic = 0;
+    quint16 version = 0;
+    quint32 count = 0;
+    stream >> magic >> version >> count;
+
+    if (snapshotMagic != magic || snapshotVersion != version)
+        return false;
+
+    for (quint32 i = 0; i < count && QDataStream::Ok == stream.status(); ++i) {
+        QString name;
+        qint32 type = 0;
+        Option option;
+
+        stream >> name >> type >> option.choices >> option.minimum >> option.maximum >> option.step;
+
+        option.type = CameraWidgetType(type);
+        if (GP_WIDGET_RADIO == option.type || GP_WIDGET_MENU == option.type)
+            parseChoices(&option);
+
+        m_options.insert(name, option);
+    }
+
+    if (QDataStream::Ok != stream.status()) {
+        qWarning() << "GPhoto: Config snapshot is corrupted";
+        invalidate();
+        return false;
+    }
+
+    m_snapshot = true;
+    return true;
+}
+
+bool GPhotoCameraConfig::isStale(const QString &name) const
+{
+    return m_staleNames.contains(name);
+}
+
+void GPhotoCameraConfig::markStale(const QString &name)
+{
+    m_staleNames.insert(name);
+}
+
+void GPhotoCameraConfig::replaceWidget(const QString &name, CameraWidget *widget)
+{
+    m_replacements.erase(name);
+    m_replacements.emplace(name, CameraWidgetPtr(widget, gp_widget_free));
+    m_options.insert(name, readOption(widget));
+    m_staleNames.remove(name);
+}
+
+CameraWidget* GPhotoCameraConfig::root() const
+{
+    return m_root.get();
+}
+
+CameraWidget* GPhotoCameraConfig::widget(const QString &name) const
+{
+    auto it = m_replacements.find(name);
+    return (m_replacements.cend() != it) ? it->second.get() : m_index.value(name);
+}
+
+CameraWidget* GPhotoCameraConfig::treeWidget(const QString &name) const
+{
+    return m_index.value(name);
+}
+
+QStringList GPhotoCameraConfig::names() const
+{
+    auto result = m_options.keys();
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+bool GPhotoCameraConfig::hasOption(const QString &name) const
+{
+    return m_options.contains(name);
+}
+
+GPhotoCameraConfig::Option GPhotoCameraConfig::option(const QString &name) const
+{
+    return m_options.value(name);
+}
+
+QString GPhotoCameraConfig::nearestChoice(const QString &name, double value, double tolerance) const
+{
+    auto it = m_options.constFind(name);
+    if (m_options.cend() == it || it->values.isEmpty())
+        return QString();
+
+    const auto &values = it->values;
+    auto upper = std::lower_bound(values.cbegin(), values.cend(), value);
+
+    auto nearest = (values.cend() == upper) ? std::prev(upper) : upper;
+    if (values.cbegin() != upper && qAbs(*std::prev(upper) - value) < qAbs(*nearest - value))
+        nearest = std::prev(upper);
+
+    if (qAbs(*nearest - value) >= tolerance)
+        return QString();
+
+    return it->choices.at(it->indexes.at(int(std::distance(values.cbegin(), nearest))));
+}
+
+QString GPhotoCameraConfig::firstNonNumericChoice(const QString &name) const
+{
+    auto it = m_options.constFind(name);
+    if (m_options.cend() == it || it->firstNonNumeric < 0)
+        return QString();
+
+    return it->choices.at(it->firstNonNumeric);
+}
+
+bool GPhotoCameraConfig::parseChoice(const QString &choice, double *value)
+{
+    auto ok = false;
+
+    // Fractions are used for shutter speeds
+    if (1 == choice.count('/')) {
+        const auto &fraction = choice.split('/');
+
+        auto numerator = fraction.first().toInt(&ok);
+        if (!ok)
+            return false;
+
+        auto denominator = fraction.last().toInt(&ok);
+        if (!ok || 0 == denominator)
+            return false;
+
+        *value = double(numerator) / denominator;
+        return true;
+    }
+
+    // We use a workaround for flawed russian i18n of gphoto2 strings
+    auto result = QString(choice).replace(',', '.').toDouble(&ok);
+    if (ok)
+        *value = result;
+
+    return ok;
+}
+
+void GPhotoCameraConfig::indexWidget(CameraWidget *widget, const QString &parentPath)
+{
+    const char *gpName = nullptr;
+    if (gp_widget_get_name(widget, &gpName) < GP_OK || !gpName)
+        return;
+
+    const auto &name = QString::fromLatin1(gpName);
+    const auto &path = parentPath + QLatin1Char('/') + name;
+
+    // gp_widget_get_child_by_name() checks the widget itself and then recurses into each child in turn,
+    // so this pre-order walk keeps the first widget for a duplicated name, the one gphoto finds
+    if (!m_index.contains(name)) {
+        m_index.insert(name, widget);
+
+        CameraWidgetType type;
+        if (gp_widget_get_type(widget, &type) >= GP_OK && GP_WIDGET_SECTION != type && GP_WIDGET_WINDOW != type)
+            m_options.insert(name, readOption(widget));
+    }
+    m_index.insert(path, widget);
+
+    auto count = gp_widget_count_children(widget);
+    for (auto i = 0; i < count; ++i) {
+        CameraWidget *child = nullptr;
+        if (gp_widget_get_child(widget, i, &child) >= GP_OK)
+            indexWidget(child, path);
+    }
+}
+
+GPhotoCameraConfig::Option GPhotoCameraConfig::readOption(CameraWidget *widget)
+{
+    Option option;
+    if (gp_widget_get_type(widget, &option.type) < GP_OK)
+        return option;
+
+    if (GP_WIDGET_RANGE == option.type) {
+        gp_widget_get_range(widget, &option.minimum, &option.maximum, &option.step);
+    } else if (GP_WIDGET_RADIO == option.type || GP_WIDGET_MENU == option.type) {
+        auto count = gp_widget_count_choices(widget);
+        for (auto i = 0; i < count; ++i) {
+            const char *choice = nullptr;
+            gp_widget_get_choice(widget, i, &choice);
+            option.choices.append(QString::fromLocal8Bit(choice));
+        }
+
+        parseChoices(&option);
+    }
+
+    return option;
+}
@@ -0,0 +1,99 @@
+#ifndef GPHOTOCAMERACONFIG_H
+#define GPHOTOCAMERACONFIG_H
+
+#include <map>
+#include <memory>
+
+#include <QByteArray>
+#include <QHash>
+#include <QSet>
+#include <QStringList>
+#include <QVector>
+
+#include <gphoto2/gphoto2-camera.h>
+#include <gphoto2/gphoto2-widget.h>
+
+using CameraWidgetPtr = std::unique_ptr<CameraWidget, int (*)(CameraWidget*)>;
+
+/** Cached configuration widget tree of a single camera.
+ *
+ * The tree is fetched from the camera once and kept until something
+ * invalidates it (a config write, a property change event or an explicit
+ * refresh), so parameter access doesn't cost a USB round trip each time.
+ * Widgets are indexed by name and by full path ("/main/capturesettings/iso")
+ * when the tree is loaded, so a lookup doesn't walk the tree.
+ *
+ * Single options may be marked stale and replaced with a widget fetched by
+ * gp_camera_get_single_config() without reloading the whole tree.
+ *
+ * Every option is also described by a schema: its type, choices and range.
+ * Choices of radio and menu widgets are parsed to numbers once and kept
+ * sorted, so a nearest value lookup is a binary search. The schema can be
+ * saved to a snapshot and restored without a widget tree, which serves
+ * choices and ranges of a known camera before its config is fetched.
+ */
+class GPhotoCameraConfig final
+{
+public:
+    struct Option {
+        CameraWidgetType type = GP_WIDGET_TEXT;
+        QStringList choices;
+        float minimum = 0.0F;
+        float maximum = 0.0F;
+        float step = 0.0F;
+
+        /// Numeric choice values in ascending order
+        QVector<double> values;
+        /// Choice index for every numeric value
+        QVector<int> indexes;
+        int firstNonNumeric = -1;
+    };
+
+    GPhotoCameraConfig();
+    ~GPhotoCameraConfig();
+
+    GPhotoCameraConfig(GPhotoCameraConfig&&) = delete;
+    GPhotoCameraConfig& operator=(GPhotoCameraConfig&&) = delete;
+
+    bool isValid() const;
+    bool isSnapshot() const;
+
+    bool load(Camera *camera, GPContext *context);
+    void invalidate();
+
+    QByteArray snapshot() const;
+    bool loadSnapshot(const QByteArray &data);
+
+    bool isStale(const QString &name) const;
+    void markStale(const QString &name);
+    void replaceWidget(const QString &name, CameraWidget *widget);
+
+    CameraWidget* root() const;
+    CameraWidget* widget(const QString &name) const;
+    CameraWidget* treeWidget(const QString &name) const;
+
+    QStringList names() const;
+    bool hasOption(const QString &name) const;
+    Option option(const QString &name) const;
+
+    QString nearestChoice(const QString &name, double value, double tolerance) const;
+    QString firstNonNumericChoice(const QString &name) const;
+
+    static bool parseChoice(const QString &choice, double *value);
+
+private:
+    Q_DISABLE_COPY(GPhotoCameraConfig)
+
+    void indexWidget(CameraWidget *widget, const QString &parentPath);
+
+    static Option readOption(CameraWidget *widget);
+
+    CameraWidgetPtr m_root;
+    QHash<QString, CameraWidget*> m_index;
+    QHash<QString, Option> m_options;
+    std::map<QString, CameraWidgetPtr> m_replacements;
+    QSet<QString> m_staleNames;
+    bool m_snapshot = false;
+};
+
+#endif // GPHOTOCAMERACONFIG_H
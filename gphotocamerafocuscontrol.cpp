@@ -1,5 +1,10 @@
 #include "gphotocamerafocuscontrol.h"
 
+namespace {
+    // Part of frame width and height taken by contrast focus region
+    constexpr auto focusRegionSize = 0.2;
+}
+
 GPhotoCameraFocusControl::GPhotoCameraFocusControl(QObject *parent)
     : QCameraFocusControl(parent)
     , m_focusMode(QCameraFocus::AutoFocus)
@@ -44,7 +49,14 @@ void GPhotoCameraFocusControl::setFocusPointMode(QCameraFocus::FocusPointMode mo
 
 bool GPhotoCameraFocusControl::isFocusPointModeSupported(QCameraFocus::FocusPointMode mode) const
 {
-    return (mode == QCameraFocus::FocusPointAuto);
+    switch (mode) {
+    case QCameraFocus::FocusPointAuto:
+    case QCameraFocus::FocusPointCenter:
+    case QCameraFocus::FocusPointCustom:
+        return true;
+    default:
+        return false;
+    }
 }
 
 QPointF GPhotoCameraFocusControl::customFocusPoint() const
@@ -57,10 +69,24 @@ void GPhotoCameraFocusControl::setCustomFocusPoint(const QPointF &point)
   if (m_focusPoint != point) {
       m_focusPoint = point;
       emit customFocusPointChanged(m_focusPoint);
+
+      if (QCameraFocus::FocusPointCustom == m_focusPointMode)
+          emit focusZonesChanged();
   }
 }
 
 QCameraFocusZoneList GPhotoCameraFocusControl::focusZones() const
 {
-    return QCameraFocusZoneList();
+    return {QCameraFocusZone(focusRegion(), QCameraFocusZone::Selected)};
+}
+
+QRectF GPhotoCameraFocusControl::focusRegion() const
+{
+    const auto &center = (QCameraFocus::FocusPointCustom == m_focusPointMode) ? m_focusPoint : QPointF(0.5, 0.5);
+
+    // Region stays whole inside the frame
+    const auto half = focusRegionSize / 2;
+    const auto x = qBound(half, center.x(), 1 - half);
+    const auto y = qBound(half, center.y(), 1 - half);
+    return QRectF(x - half, y - half, focusRegionSize, focusRegionSize);
 }
@@ -20,6 +20,9 @@ class GPhotoCameraFocusControl final : public QCameraFocusControl
     void setCustomFocusPoint(const QPointF &point) final;
     QCameraFocusZoneList focusZones() const final;
 
+    /// Frame region the contrast focus is measured in, relative to frame size
+    QRectF focusRegion() const;
+
   private:
     QCameraFocus::FocusModes m_focusMode;
     QCameraFocus::FocusPointMode m_focusPointMode;
@@ -1,3 +1,5 @@
+#include <QDebug>
+
 #include "gphotocameraimagecapturecontrol.h"
 #include "gphotocamerasession.h"
 
@@ -12,6 +14,7 @@ GPhotoCameraImageCaptureControl::GPhotoCameraImageCaptureControl(GPhotoCameraSes
     connect(m_session, &Session::imageCaptured, this, &Control::imageCaptured);
     connect(m_session, &Session::imageCaptureError, this, &Control::error);
     connect(m_session, &Session::imageSaved, this, &Control::imageSaved);
+    connect(m_session, &Session::motionCaptureTriggered, this, &Control::motionCaptureTriggered);
     connect(m_session, &Session::readyForCaptureChanged, this, &Control::readyForCaptureChanged);
 }
 
@@ -37,3 +40,46 @@ int GPhotoCameraImageCaptureControl::capture(const QString &fileName)
 void GPhotoCameraImageCaptureControl::cancelCapture()
 {
 }
+
+QVariantList GPhotoCameraImageCaptureControl::motionRegions() const
+{
+    QVariantList result;
+    for (const auto &region : m_session->motionRegions())
+        result.append(region);
+
+    return result;
+}
+
+void GPhotoCameraImageCaptureControl::setMotionRegions(const QVariantList &regions)
+{
+    QVector<QRectF> result;
+    for (const auto &region : regions) {
+        const auto &rect = region.toRectF();
+        if (rect.isValid())
+            result.append(rect);
+        else
+            qWarning() << "GPhoto: Invalid motion region" << region;
+    }
+
+    m_session->setMotionRegions(result);
+}
+
+int GPhotoCameraImageCaptureControl::motionThreshold() const
+{
+    return m_session->motionThreshold();
+}
+
+void GPhotoCameraImageCaptureControl::setMotionThreshold(int threshold)
+{
+    m_session->setMotionThreshold(threshold);
+}
+
+int GPhotoCameraImageCaptureControl::motionCooldown() const
+{
+    return m_session->motionCooldown();
+}
+
+void GPhotoCameraImageCaptureControl::setMotionCooldown(int msec)
+{
+    m_session->setMotionCooldown(msec);
+}
@@ -2,12 +2,26 @@
 #define GPHOTOCAMERAIMAGECAPTURECONTROL_H
 
 #include <QCameraImageCaptureControl>
+#include <QVariantList>
 
 class GPhotoCameraSession;
 
+/** Still image capture.
+ *
+ * Besides captures requested by the application, camera may capture on
+ * motion in live view while "motionThreshold" property is not zero, see
+ * GPhotoMotionDetector. "motionRegions" is a list of rectangles relative
+ * to frame size which are watched, empty list watches the whole frame,
+ * "motionCooldown" is the least time between motion captures in msecs.
+ * Motion captures get negative ids announced by motionCaptureTriggered(),
+ * then they are reported by the usual capture signals.
+ */
 class GPhotoCameraImageCaptureControl final : public QCameraImageCaptureControl
 {
     Q_OBJECT
+    Q_PROPERTY(QVariantList motionRegions READ motionRegions WRITE setMotionRegions)
+    Q_PROPERTY(int motionThreshold READ motionThreshold WRITE setMotionThreshold)
+    Q_PROPERTY(int motionCooldown READ motionCooldown WRITE setMotionCooldown)
 public:
     explicit GPhotoCameraImageCaptureControl(GPhotoCameraSession *session, QObject *parent = nullptr);
     ~GPhotoCameraImageCaptureControl() = default;
@@ -23,6 +37,16 @@ public:
     int capture(const QString &fileName) final;
     void cancelCapture() final;
 
+    QVariantList motionRegions() const;
+    void setMotionRegions(const QVariantList &regions);
+    int motionThreshold() const;
+    void setMotionThreshold(int threshold);
+    int motionCooldown() const;
+    void setMotionCooldown(int msec);
+
+signals:
+    void motionCaptureTriggered(int id);
+
 private:
     Q_DISABLE_COPY(GPhotoCameraImageCaptureControl)
 
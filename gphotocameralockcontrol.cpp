@@ -1,18 +1,53 @@
 #include "gphotocameralockcontrol.h"
 #include "gphotocamerasession.h"
+#include "gphotopreviewworker.h"
 
 #include <QCameraFocusControl>
 
 namespace {
     constexpr auto autofocusdriveParameter = "autofocusdrive";
     constexpr auto cancelautofocusParameter = "cancelautofocus";
+    constexpr auto focusmodeParameter = "focusmode";
+    constexpr auto manualfocusdriveParameter = "manualfocusdrive";
+
+    // Range drives (Nikon) take focus motor steps, the sign gives direction
+    constexpr auto fineRangeStep = 100.0;
+    constexpr auto coarseRangeStep = 400.0;
+
+    // Lens keeps moving for a while after camera accepts the drive, microseconds
+    constexpr auto lensSettleTime = 100000;
+    // Search gives up when live view stops delivering sharpness
+    constexpr auto sampleTimeout = 3000;
+    // Every step waits for the camera to take the drive, a search may not hold the lock forever
+    constexpr auto defaultSearchTimeout = 15000;
+
+    int driveStep(const QString &choice)
+    {
+        // Choices are like "Near 1" or "Far 3", only the number survives translation
+        auto ok = false;
+        auto step = choice.section(QLatin1Char(' '), -1).toInt(&ok);
+        return ok ? step : 0;
+    }
 }
 
 GPhotoCameraLockControl::GPhotoCameraLockControl(GPhotoCameraSession *session, QObject *parent)
   : QCameraLocksControl(parent)
   , m_session(session)
 {
-    connect(session, &GPhotoCameraSession::statusChanged, this, &GPhotoCameraLockControl::onStatusChanged);
+    using Session = GPhotoCameraSession;
+    using Control = GPhotoCameraLockControl;
+
+    connect(session, &Session::focusSharpnessMeasured, this, &Control::onFocusSharpnessMeasured);
+    connect(session, &Session::parametersChanged, this, &Control::onParametersChanged);
+    connect(session, &Session::statusChanged, this, &Control::onStatusChanged);
+
+    m_sampleTimer.setSingleShot(true);
+    m_sampleTimer.setInterval(sampleTimeout);
+    connect(&m_sampleTimer, &QTimer::timeout, this, &Control::onSearchTimeout);
+
+    m_searchTimer.setSingleShot(true);
+    m_searchTimer.setInterval(defaultSearchTimeout);
+    connect(&m_searchTimer, &QTimer::timeout, this, &Control::onSearchTimeout);
 }
 
 QCamera::LockTypes GPhotoCameraLockControl::supportedLocks() const
@@ -51,10 +86,74 @@ void GPhotoCameraLockControl::unlock(QCamera::LockTypes locks)
         stopFocusing();
 }
 
+bool GPhotoCameraLockControl::contrastSearch() const
+{
+    return m_contrastSearch;
+}
+
+void GPhotoCameraLockControl::setContrastSearch(bool enabled)
+{
+    m_contrastSearch = enabled;
+}
+
+int GPhotoCameraLockControl::searchTimeout() const
+{
+    return m_searchTimer.interval();
+}
+
+void GPhotoCameraLockControl::setSearchTimeout(int msec)
+{
+    m_searchTimer.setInterval(msec);
+}
+
+void GPhotoCameraLockControl::onFocusSharpnessMeasured(qreal sharpness, qint64 timestamp)
+{
+    // Frames taken while lens was moving show no particular position
+    if (!m_focusSearch.isActive() || m_driving || timestamp < m_driveFinished)
+        return;
+
+    m_sampleTimer.start();
+
+    switch (m_focusSearch.addSample(sharpness)) {
+    case GPhotoFocusSearch::Action::StepCoarse:
+        driveFocus(true);
+        break;
+    case GPhotoFocusSearch::Action::StepFine:
+        driveFocus(false);
+        break;
+    case GPhotoFocusSearch::Action::Locked:
+        finishContrastSearch(QCamera::Locked, QCamera::UserRequest);
+        break;
+    case GPhotoFocusSearch::Action::Failed:
+        finishContrastSearch(QCamera::Unlocked, QCamera::LockFailed);
+        break;
+    }
+}
+
+void GPhotoCameraLockControl::onParametersChanged(const QStringList &names)
+{
+    // Focus mode switched on camera body drops the lock
+    if (QCamera::Locked == m_lockStatus.value(QCamera::LockFocus)
+            && names.contains(QLatin1String(focusmodeParameter))) {
+        setLockStatus(QCamera::LockFocus, QCamera::Unlocked, QCamera::LockLost);
+    }
+}
+
 void GPhotoCameraLockControl::onStatusChanged(QCamera::Status status)
 {
     if (QCamera::ActiveStatus == status && m_pendingLocks & QCamera::LockFocus) {
         startFocusing();
+    } else if (QCamera::ActiveStatus != status && m_focusSearch.isActive()) {
+        m_focusSearch.stop();
+        finishContrastSearch(QCamera::Unlocked, QCamera::LockLost);
+    }
+}
+
+void GPhotoCameraLockControl::onSearchTimeout()
+{
+    if (m_focusSearch.isActive()) {
+        m_focusSearch.stop();
+        finishContrastSearch(QCamera::Unlocked, QCamera::LockFailed);
     }
 }
 
@@ -71,24 +170,147 @@ void GPhotoCameraLockControl::setLockStatus(QCamera::LockType lock, QCamera::Loc
 void GPhotoCameraLockControl::startFocusing()
 {
     if (QCamera::ActiveStatus == m_session->status()) {
-        if (m_session->setParameter(QLatin1String(autofocusdriveParameter), true)) {
-            m_pendingLocks &= ~QCamera::LockFocus;
-            setLockStatus(QCamera::LockFocus, QCamera::Locked, QCamera::UserRequest);
-        } else {
-            setLockStatus(QCamera::LockFocus, QCamera::Locked, QCamera::LockFailed);
+        // Report searching until camera answers
+        m_pendingLocks |= QCamera::LockFocus;
+        setLockStatus(QCamera::LockFocus, QCamera::Searching, QCamera::UserRequest);
+
+        // Camera focuses itself, e.g. by phase detection, without stepping the lens
+        if (!m_contrastSearch) {
+            driveAutofocus();
+            return;
         }
+
+        m_session->parameter(QLatin1String(manualfocusdriveParameter), this, [this] (const QVariant &value) {
+            // Lock may have been released meanwhile
+            if (!(m_pendingLocks & QCamera::LockFocus))
+                return;
+
+            if (!value.isValid()) {
+                driveAutofocus();
+                return;
+            }
+
+            if (QVariant::String != value.type()) {
+                m_fineDrive[0] = -fineRangeStep;
+                m_fineDrive[1] = fineRangeStep;
+                m_coarseDrive[0] = -coarseRangeStep;
+                m_coarseDrive[1] = coarseRangeStep;
+                startContrastSearch();
+                return;
+            }
+
+            m_session->parameterValues(QLatin1String(manualfocusdriveParameter), QMetaType::QString, this,
+                                       [this] (const QVariantList &choices) {
+                if (!(m_pendingLocks & QCamera::LockFocus))
+                    return;
+
+                if (setDriveChoices(choices))
+                    startContrastSearch();
+                else
+                    driveAutofocus();
+            });
+        });
     }
 }
 
 void GPhotoCameraLockControl::stopFocusing()
 {
-    if (m_session->parameter(QLatin1String(cancelautofocusParameter)).isValid()) {
-        // Canon
-        if (m_session->setParameter(QLatin1String(cancelautofocusParameter), true)) {
+    if (m_focusSearch.isActive()) {
+        m_focusSearch.stop();
+        finishContrastSearch(QCamera::Unlocked, QCamera::UserRequest);
+    }
+
+    m_session->parameter(QLatin1String(cancelautofocusParameter), this, [this] (const QVariant &value) {
+        if (value.isValid()) {
+            // Canon
+            m_session->setParameter(QLatin1String(cancelautofocusParameter), true, this, [this] (bool ok) {
+                if (ok)
+                    setLockStatus(QCamera::LockFocus, QCamera::Unlocked, QCamera::UserRequest);
+            });
+        } else {
+            // Nikon
             setLockStatus(QCamera::LockFocus, QCamera::Unlocked, QCamera::UserRequest);
         }
-    } else {
-        // Nikon
-        setLockStatus(QCamera::LockFocus, QCamera::Unlocked, QCamera::UserRequest);
+    });
+}
+
+void GPhotoCameraLockControl::driveAutofocus()
+{
+    m_session->setParameter(QLatin1String(autofocusdriveParameter), true, this, [this] (bool ok) {
+        m_pendingLocks &= ~QCamera::LockFocus;
+        if (ok)
+            setLockStatus(QCamera::LockFocus, QCamera::Locked, QCamera::UserRequest);
+        else
+            setLockStatus(QCamera::LockFocus, QCamera::Locked, QCamera::LockFailed);
+    });
+}
+
+bool GPhotoCameraLockControl::setDriveChoices(const QVariantList &choices)
+{
+    // Canon lists "Near 1" to "Near 3", then "None", then "Far 1" to "Far 3"
+    const auto middle = choices.size() / 2;
+    if (choices.size() < 5 || 0 == choices.size() % 2)
+        return false;
+
+    for (auto side = 0; side < 2; ++side) {
+        m_fineDrive[side].clear();
+        m_coarseDrive[side].clear();
+
+        const auto begin = (0 == side) ? 0 : middle + 1;
+        const auto end = (0 == side) ? middle : choices.size();
+        for (auto i = begin; i < end; ++i) {
+            const auto &choice = choices.at(i).toString();
+            const auto step = driveStep(choice);
+            if (1 == step)
+                m_fineDrive[side] = choice;
+            else if (2 == step)
+                m_coarseDrive[side] = choice;
+        }
+
+        if (!m_fineDrive[side].isValid() || !m_coarseDrive[side].isValid())
+            return false;
     }
+
+    return true;
+}
+
+void GPhotoCameraLockControl::startContrastSearch()
+{
+    m_focusSearch.start();
+    m_driving = false;
+    m_driveFinished = GPhotoPreviewWorker::clock();
+    m_session->setFocusMeasurementEnabled(true);
+    m_sampleTimer.start();
+    m_searchTimer.start();
+}
+
+void GPhotoCameraLockControl::driveFocus(bool coarse)
+{
+    const auto side = (0 < m_focusSearch.direction()) ? 1 : 0;
+    const auto &value = coarse ? m_coarseDrive[side] : m_fineDrive[side];
+
+    m_driving = true;
+    m_session->setParameter(QLatin1String(manualfocusdriveParameter), value, this, [this] (bool ok) {
+        m_driving = false;
+        if (!m_focusSearch.isActive())
+            return;
+
+        if (!ok) {
+            m_focusSearch.stop();
+            finishContrastSearch(QCamera::Unlocked, QCamera::LockFailed);
+            return;
+        }
+
+        m_driveFinished = GPhotoPreviewWorker::clock() + lensSettleTime;
+        m_sampleTimer.start();
+    });
+}
+
+void GPhotoCameraLockControl::finishContrastSearch(QCamera::LockStatus status, QCamera::LockChangeReason reason)
+{
+    m_sampleTimer.stop();
+    m_searchTimer.stop();
+    m_session->setFocusMeasurementEnabled(false);
+    m_pendingLocks &= ~QCamera::LockFocus;
+    setLockStatus(QCamera::LockFocus, status, reason);
 }
@@ -3,12 +3,28 @@
 
 #include <QCamera>
 #include <QCameraLocksControl>
+#include <QTimer>
+#include <QVariant>
+
+#include "gphotofocussearch.h"
 
 class GPhotoCameraSession;
 
+/** Focus lock.
+ *
+ * While "contrastSearch" property is set, cameras with manualfocusdrive
+ * are focused by contrast: lens is driven in steps while live view
+ * sharpness is measured, see GPhotoFocusSearch, so the lock reports
+ * whether focus was really found. The search fails when it takes longer
+ * than "searchTimeout" msecs. Otherwise, or when camera has no
+ * manualfocusdrive, camera focuses itself by autofocusdrive and the lock
+ * is reported once camera takes it.
+ */
 class GPhotoCameraLockControl final : public QCameraLocksControl
 {
     Q_OBJECT
+    Q_PROPERTY(bool contrastSearch READ contrastSearch WRITE setContrastSearch)
+    Q_PROPERTY(int searchTimeout READ searchTimeout WRITE setSearchTimeout)
   public:
     explicit GPhotoCameraLockControl(GPhotoCameraSession *session, QObject *parent = nullptr);
 
@@ -17,17 +33,41 @@ class GPhotoCameraLockControl final : public QCameraLocksControl
     void searchAndLock(QCamera::LockTypes locks) final;
     void unlock(QCamera::LockTypes locks) final;
 
+    bool contrastSearch() const;
+    void setContrastSearch(bool enabled);
+
+    int searchTimeout() const;
+    void setSearchTimeout(int msec);
+
   private slots:
+    void onFocusSharpnessMeasured(qreal sharpness, qint64 timestamp);
+    void onParametersChanged(const QStringList &names);
     void onStatusChanged(QCamera::Status status);
+    void onSearchTimeout();
 
   private:
     void setLockStatus(QCamera::LockType lock, QCamera::LockStatus status, QCamera::LockChangeReason reason);
     void startFocusing();
     void stopFocusing();
+    void driveAutofocus();
+    bool setDriveChoices(const QVariantList &choices);
+    void startContrastSearch();
+    void driveFocus(bool coarse);
+    void finishContrastSearch(QCamera::LockStatus status, QCamera::LockChangeReason reason);
 
     GPhotoCameraSession *const m_session;
     QCamera::LockTypes m_pendingLocks;
     QMap<QCamera::LockType, QCamera::LockStatus> m_lockStatus;
+
+    GPhotoFocusSearch m_focusSearch;
+    // Drive values towards close focus and towards infinity
+    QVariant m_fineDrive[2];
+    QVariant m_coarseDrive[2];
+    QTimer m_sampleTimer;
+    QTimer m_searchTimer;
+    qint64 m_driveFinished = 0;
+    bool m_driving = false;
+    bool m_contrastSearch = true;
 };
 
 #endif // GPHOTOCAMERALOCKCONTROL_H
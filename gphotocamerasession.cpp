@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <iterator>
+
 #include <QAbstractVideoSurface>
 #include <QDebug>
 #include <QFile>
@@ -6,34 +9,32 @@
 #include <QVideoSurfaceFormat>
 
 #include "gphotocamera.h"
+#include "gphotocamerachannel.h"
 #include "gphotocamerafocuscontrol.h"
 #include "gphotocamerasession.h"
 #include "gphotocontroller.h"
+#include "gphotofocusmeasure.h"
+#include "gphotoframeexporter.h"
+#include "gphotopreviewworker.h"
 
 namespace {
     constexpr auto maxDownscaleSteps = 8;
     constexpr auto maxFileIndex = 9999;
     constexpr auto maxPreviewWidth = 800;
+    constexpr auto defaultMotionCooldown = 5000;
+    constexpr auto previewRateWindow = 1000;
+
+    const QRectF fullRegion(0, 0, 1, 1);
 }
 
+const int GPhotoCameraSession::PreviewStatistics::latencyBounds[] = {10, 20, 35, 50, 75, 100, 150};
+
 GPhotoCameraSession::GPhotoCameraSession(std::weak_ptr<GPhotoController> controller, QObject *parent)
     : QObject(parent)
     , m_controller(std::move(controller))
     , m_cameraFocusControl(new GPhotoCameraFocusControl())
+    , m_motionCooldown(defaultMotionCooldown)
 {
-    if (const auto &controller = m_controller.lock()) {
-        using Controller = GPhotoController;
-        using Session = GPhotoCameraSession;
-
-        connect(controller.get(), &Controller::captureModeChanged, this, &Session::onCaptureModeChanged);
-        connect(controller.get(), &Controller::error, this, &Session::onError);
-        connect(controller.get(), &Controller::imageCaptureError, this, &Session::onImageCaptureError);
-        connect(controller.get(), &Controller::imageCaptured, this, &Session::onImageCaptured);
-        connect(controller.get(), &Controller::previewCaptured, this, &Session::onPreviewCaptured);
-        connect(controller.get(), &Controller::readyForCaptureChanged, this, &Session::onReadyForCaptureChanged);
-        connect(controller.get(), &Controller::stateChanged, this, &Session::onStateChanged);
-        connect(controller.get(), &Controller::statusChanged, this, &Session::onStatusChanged);
-    }
 }
 
 GPhotoCameraSession::~GPhotoCameraSession() = default;
@@ -46,6 +47,13 @@ QList<QByteArray> GPhotoCameraSession::cameraNames() const
     return {};
 }
 
+void GPhotoCameraSession::cameraNames(QObject *context,
+                                      std::function<void (const QList<QByteArray> &)> callback) const
+{
+    if (const auto &controller = m_controller.lock())
+        controller->cameraNames(context, std::move(callback));
+}
+
 QByteArray GPhotoCameraSession::defaultCameraName() const
 {
     if (const auto &controller = m_controller.lock())
@@ -54,6 +62,13 @@ QByteArray GPhotoCameraSession::defaultCameraName() const
     return {};
 }
 
+void GPhotoCameraSession::defaultCameraName(QObject *context,
+                                            std::function<void (const QByteArray &)> callback) const
+{
+    if (const auto &controller = m_controller.lock())
+        controller->defaultCameraName(context, std::move(callback));
+}
+
 QCamera::State GPhotoCameraSession::state() const
 {
     return m_state;
@@ -61,6 +76,10 @@ QCamera::State GPhotoCameraSession::state() const
 
 void GPhotoCameraSession::setState(QCamera::State state)
 {
+    // Camera object may have been created after surface was set
+    if (QCamera::ActiveState == state)
+        updatePreviewFormat();
+
     if (const auto &controller = m_controller.lock())
         controller->setState(m_cameraIndex, state);
 }
@@ -130,8 +149,153 @@ QAbstractVideoSurface* GPhotoCameraSession::surface() const
 
 void GPhotoCameraSession::setSurface(QAbstractVideoSurface *surface)
 {
-    if (m_surface != surface)
-        m_surface = surface;
+    if (m_surface == surface)
+        return;
+
+    using Session = GPhotoCameraSession;
+    using Surface = QAbstractVideoSurface;
+
+    if (m_surface) {
+        disconnect(m_surface, &Surface::supportedFormatsChanged, this, &Session::updatePreviewFormat);
+    }
+
+    m_surface = surface;
+
+    if (m_surface) {
+        connect(m_surface, &Surface::supportedFormatsChanged, this, &Session::updatePreviewFormat);
+    }
+
+    updatePreviewFormat();
+}
+
+qreal GPhotoCameraSession::previewFrameRate() const
+{
+    return m_previewFrameRate;
+}
+
+void GPhotoCameraSession::setPreviewFrameRate(qreal frameRate)
+{
+    if (qFuzzyCompare(m_previewFrameRate, frameRate))
+        return;
+
+    m_previewFrameRate = frameRate;
+    updatePreviewFormat();
+}
+
+QSize GPhotoCameraSession::previewResolution() const
+{
+    return m_previewResolution;
+}
+
+void GPhotoCameraSession::setPreviewResolution(const QSize &size)
+{
+    if (m_previewResolution == size)
+        return;
+
+    m_previewResolution = size;
+    updatePreviewFormat();
+}
+
+QRectF GPhotoCameraSession::previewCrop() const
+{
+    return m_previewCrop;
+}
+
+void GPhotoCameraSession::setPreviewCrop(const QRectF &region)
+{
+    // Whole frame and a region outside of it both mean no crop
+    auto crop = region.intersected(fullRegion);
+    if (crop.isEmpty() || fullRegion == crop)
+        crop = QRectF();
+
+    if (m_previewCrop != crop) {
+        m_previewCrop = crop;
+        updatePreviewFormat();
+    }
+}
+
+bool GPhotoCameraSession::startFrameExport(const QString &name, int slotCount, int slotSize)
+{
+    if (!m_frameExporter)
+        m_frameExporter.reset(new GPhotoFrameExporter);
+
+    if (!m_frameExporter->open(name, slotCount, slotSize)) {
+        m_frameExporter.reset();
+        return false;
+    }
+
+    // Live view may have been paused for the lack of a viewfinder
+    if (0 < m_unconsumedPreviewFrames) {
+        if (const auto &controller = m_controller.lock())
+            controller->previewConsumed(m_cameraIndex, m_unconsumedPreviewFrames);
+        m_unconsumedPreviewFrames = 0;
+    }
+
+    return true;
+}
+
+void GPhotoCameraSession::stopFrameExport()
+{
+    m_frameExporter.reset();
+}
+
+QString GPhotoCameraSession::frameExportName() const
+{
+    return m_frameExporter ? m_frameExporter->name() : QString();
+}
+
+void GPhotoCameraSession::attachProbe()
+{
+    // Exposure statistics are delivered with probed frames only
+    if (0 == m_probeCount++) {
+        if (const auto &controller = m_controller.lock())
+            controller->setPreviewStatisticsEnabled(m_cameraIndex, true);
+    }
+}
+
+void GPhotoCameraSession::detachProbe()
+{
+    Q_ASSERT(0 < m_probeCount);
+    if (0 == --m_probeCount) {
+        if (const auto &controller = m_controller.lock())
+            controller->setPreviewStatisticsEnabled(m_cameraIndex, false);
+    }
+}
+
+qreal GPhotoCameraSession::probeFrameRate() const
+{
+    return m_probeFrameRate;
+}
+
+void GPhotoCameraSession::setProbeFrameRate(qreal frameRate)
+{
+    m_probeFrameRate = qMax(qreal(0), frameRate);
+}
+
+QSize GPhotoCameraSession::probeFrameSize() const
+{
+    return m_probeFrameSize;
+}
+
+void GPhotoCameraSession::setProbeFrameSize(const QSize &size)
+{
+    m_probeFrameSize = size;
+}
+
+GPhotoCameraSession::PreviewStatistics GPhotoCameraSession::previewStatistics() const
+{
+    return m_previewStatistics;
+}
+
+void GPhotoCameraSession::resetPreviewStatistics()
+{
+    m_previewStatistics = PreviewStatistics();
+    m_previewStatisticsTimer.invalidate();
+    m_windowDeliveredFrames = 0;
+    m_windowDroppedFrames = 0;
+    m_previewSequenceKnown = false;
+
+    emit previewStatisticsChanged();
 }
 
 QVariant GPhotoCameraSession::parameter(const QString &name) const
@@ -142,6 +306,13 @@ QVariant GPhotoCameraSession::parameter(const QString &name) const
     return {};
 }
 
+void GPhotoCameraSession::parameter(const QString &name, QObject *context,
+                                    std::function<void (const QVariant &)> callback) const
+{
+    if (const auto &controller = m_controller.lock())
+        controller->parameter(m_cameraIndex, name, context, std::move(callback));
+}
+
 bool GPhotoCameraSession::setParameter(const QString &name, const QVariant &value)
 {
     if (const auto &controller = m_controller.lock())
@@ -150,6 +321,28 @@ bool GPhotoCameraSession::setParameter(const QString &name, const QVariant &valu
     return false;
 }
 
+void GPhotoCameraSession::setParameter(const QString &name, const QVariant &value,
+                                       QObject *context, std::function<void (bool)> callback)
+{
+    if (const auto &controller = m_controller.lock())
+        controller->setParameter(m_cameraIndex, name, value, context, std::move(callback));
+}
+
+QVariantMap GPhotoCameraSession::setParameters(const QVariantMap &values)
+{
+    if (const auto &controller = m_controller.lock())
+        return controller->setParameters(m_cameraIndex, values);
+
+    return {};
+}
+
+void GPhotoCameraSession::setParameters(const QVariantMap &values, QObject *context,
+                                        std::function<void (const QVariantMap &)> callback)
+{
+    if (const auto &controller = m_controller.lock())
+        controller->setParameters(m_cameraIndex, values, context, std::move(callback));
+}
+
 QVariantList GPhotoCameraSession::parameterValues(const QString &name, QMetaType::Type valueType) const
 {
     if (const auto &controller = m_controller.lock())
@@ -158,23 +351,137 @@ QVariantList GPhotoCameraSession::parameterValues(const QString &name, QMetaType
     return {};
 }
 
+void GPhotoCameraSession::parameterValues(const QString &name, QMetaType::Type valueType, QObject *context,
+                                          std::function<void (const QVariantList &)> callback) const
+{
+    if (const auto &controller = m_controller.lock())
+        controller->parameterValues(m_cameraIndex, name, valueType, context, std::move(callback));
+}
+
+void GPhotoCameraSession::refreshConfig()
+{
+    if (const auto &controller = m_controller.lock())
+        controller->refreshConfig(m_cameraIndex);
+}
+
+void GPhotoCameraSession::setOperationTimeout(int timeout)
+{
+    if (const auto &controller = m_controller.lock())
+        controller->setOperationTimeout(m_cameraIndex, timeout);
+}
+
 QCameraFocusControl *GPhotoCameraSession::cameraFocusControl() const
 {
     return m_cameraFocusControl.get();
 }
 
+QRectF GPhotoCameraSession::focusRegion() const
+{
+    return m_cameraFocusControl->focusRegion();
+}
+
+void GPhotoCameraSession::setFocusMeasurementEnabled(bool enabled)
+{
+    if (m_focusMeasurementEnabled != enabled) {
+        m_focusMeasurementEnabled = enabled;
+        updatePreviewFormat();
+    }
+}
+
+int GPhotoCameraSession::focusPeakingThreshold() const
+{
+    return m_focusPeakingThreshold;
+}
+
+void GPhotoCameraSession::setFocusPeakingThreshold(int threshold)
+{
+    threshold = qMax(0, threshold);
+    if (m_focusPeakingThreshold != threshold) {
+        m_focusPeakingThreshold = threshold;
+        updatePreviewFormat();
+    }
+}
+
+QVector<QRectF> GPhotoCameraSession::motionRegions() const
+{
+    return m_motionRegions;
+}
+
+void GPhotoCameraSession::setMotionRegions(const QVector<QRectF> &regions)
+{
+    if (m_motionRegions != regions) {
+        m_motionRegions = regions;
+        updatePreviewFormat();
+    }
+}
+
+int GPhotoCameraSession::motionThreshold() const
+{
+    return m_motionThreshold;
+}
+
+void GPhotoCameraSession::setMotionThreshold(int threshold)
+{
+    threshold = qBound(0, threshold, 255);
+    if (m_motionThreshold != threshold) {
+        m_motionThreshold = threshold;
+        updatePreviewFormat();
+    }
+}
+
+int GPhotoCameraSession::motionCooldown() const
+{
+    return m_motionCooldown;
+}
+
+void GPhotoCameraSession::setMotionCooldown(int msec)
+{
+    msec = qMax(0, msec);
+    if (m_motionCooldown != msec) {
+        m_motionCooldown = msec;
+        updatePreviewFormat();
+    }
+}
+
 void GPhotoCameraSession::setCamera(int cameraIndex)
 {
     if (m_cameraIndex != cameraIndex) {
         m_cameraIndex = cameraIndex;
+        m_unconsumedPreviewFrames = 0;
+        resetPreviewStatistics();
         if (const auto &controller = m_controller.lock()) {
+            subscribe(controller->channel(cameraIndex));
             onCaptureModeChanged(cameraIndex, controller->captureMode(m_cameraIndex));
             onStateChanged(cameraIndex, controller->state(m_cameraIndex));
             onStatusChanged(cameraIndex, controller->status(m_cameraIndex));
         }
+
+        updatePreviewFormat();
     }
 }
 
+void GPhotoCameraSession::subscribe(GPhotoCameraChannel *channel)
+{
+    if (m_channel)
+        disconnect(m_channel, nullptr, this, nullptr);
+
+    m_channel = channel;
+
+    using Channel = GPhotoCameraChannel;
+    using Session = GPhotoCameraSession;
+
+    connect(channel, &Channel::captureModeChanged, this, &Session::onCaptureModeChanged);
+    connect(channel, &Channel::error, this, &Session::onError);
+    connect(channel, &Channel::imageCaptureError, this, &Session::onImageCaptureError);
+    connect(channel, &Channel::imageCaptured, this, &Session::onImageCaptured);
+    connect(channel, &Channel::motionCaptureTriggered, this, &Session::onMotionCaptureTriggered);
+    connect(channel, &Channel::parametersChanged, this, &Session::onParametersChanged);
+    connect(channel, &Channel::previewCaptured, this, &Session::onPreviewCaptured);
+    connect(channel, &Channel::readyForCaptureChanged, this, &Session::onReadyForCaptureChanged);
+    connect(channel, &Channel::stateChanged, this, &Session::onStateChanged);
+    connect(channel, &Channel::statusChanged, this, &Session::onStatusChanged);
+}
+
 void GPhotoCameraSession::onCaptureModeChanged(int cameraIndex, QCamera::CaptureModes captureMode)
 {
     if (m_cameraIndex == cameraIndex && m_captureMode != captureMode) {
@@ -263,18 +570,153 @@ void GPhotoCameraSession::onImageCaptured(int cameraIndex, int id, const QByteAr
     }
 }
 
-void GPhotoCameraSession::onPreviewCaptured(int cameraIndex, const QImage &image)
+void GPhotoCameraSession::onMotionCaptureTriggered(int cameraIndex, int id, qint64 timestamp)
 {
-    if (m_cameraIndex == cameraIndex && QCamera::ActiveState == m_state && m_surface && !image.isNull()) {
-        if (m_surface->isActive() && image.size() != m_surface->surfaceFormat().frameSize())
+    if (m_cameraIndex == cameraIndex)
+        emit motionCaptureTriggered(id, timestamp);
+}
+
+void GPhotoCameraSession::onParametersChanged(int cameraIndex, const QStringList &names)
+{
+    if (m_cameraIndex == cameraIndex)
+        emit parametersChanged(names);
+}
+
+void GPhotoCameraSession::onPreviewCaptured(int cameraIndex, const QVideoFrame &frame)
+{
+    if (m_cameraIndex != cameraIndex)
+        return;
+
+    const auto &sharpness = frame.metaData(QLatin1String(GPhotoFocusMeasure::sharpnessMetaDataKey));
+    if (sharpness.isValid())
+        emit focusSharpnessMeasured(sharpness.toReal(), frame.startTime());
+
+    // Exported frames are taken by other processes, they keep live view going without a local viewfinder
+    const auto exported = m_frameExporter && m_frameExporter->publish(frame);
+
+    // Frames nobody presents aren't acknowledged, so camera pauses live view until somebody watches it.
+    // Motion detection watches every frame in the decode thread, so it keeps live view going too.
+    if (QCamera::ActiveState != m_state || !m_surface) {
+        updatePreviewStatistics(frame, exported);
+
+        if (!exported && 0 == m_motionThreshold) {
+            ++m_unconsumedPreviewFrames;
+        } else if (const auto &controller = m_controller.lock()) {
+            controller->previewConsumed(m_cameraIndex, 1);
+        }
+        return;
+    }
+
+    if (frame.isValid()) {
+        const auto &format = m_surface->surfaceFormat();
+        if (m_surface->isActive() && (frame.size() != format.frameSize() || frame.pixelFormat() != format.pixelFormat()))
             m_surface->stop();
 
         if (!m_surface->isActive())
-            m_surface->start(QVideoSurfaceFormat(image.size(), QVideoFrame::Format_RGB32));
+            m_surface->start(QVideoSurfaceFormat(frame.size(), frame.pixelFormat()));
 
-        QVideoFrame frame(image);
         m_surface->present(frame);
-        emit videoFrameProbed(frame);
+        updatePreviewStatistics(frame, true);
+
+        if (0 < m_probeCount)
+            emit videoFrameProbed(frame);
+    }
+
+    if (const auto &controller = m_controller.lock())
+        controller->previewConsumed(m_cameraIndex, 1);
+}
+
+void GPhotoCameraSession::updatePreviewStatistics(const QVideoFrame &frame, bool presented)
+{
+    auto &statistics = m_previewStatistics;
+    const auto &sequence = frame.metaData(QLatin1String(GPhotoPreviewWorker::sequenceMetaData));
+
+    // Frames dropped on the way leave gaps in sequence numbers
+    auto dropped = presented ? 0ULL : 1ULL;
+    if (sequence.isValid()) {
+        const auto number = sequence.toULongLong();
+        if (m_previewSequenceKnown && number > m_lastPreviewSequence + 1)
+            dropped += number - m_lastPreviewSequence - 1;
+
+        m_lastPreviewSequence = number;
+        m_previewSequenceKnown = true;
+    }
+
+    statistics.droppedFrames += dropped;
+    m_windowDroppedFrames += dropped;
+
+    if (presented) {
+        ++statistics.deliveredFrames;
+        ++m_windowDeliveredFrames;
+
+        if (frame.startTime() >= 0) {
+            const auto latency = GPhotoPreviewWorker::clock() - frame.startTime();
+            const auto latencyMs = int(latency / 1000);
+            const auto &bounds = PreviewStatistics::latencyBounds;
+            const auto bucket = std::upper_bound(std::begin(bounds), std::end(bounds), latencyMs) - std::begin(bounds);
+
+            ++statistics.latencyHistogram[bucket];
+            statistics.lastLatency = latency;
+            statistics.maxLatency = qMax(statistics.maxLatency, latency);
+            statistics.totalLatency += latency;
+        }
+    }
+
+    if (!m_previewStatisticsTimer.isValid()) {
+        m_previewStatisticsTimer.start();
+        return;
+    }
+
+    const auto elapsed = m_previewStatisticsTimer.elapsed();
+    if (elapsed >= previewRateWindow) {
+        statistics.deliveredFrameRate = m_windowDeliveredFrames * 1000.0 / elapsed;
+        statistics.droppedFrameRate = m_windowDroppedFrames * 1000.0 / elapsed;
+        m_windowDeliveredFrames = 0;
+        m_windowDroppedFrames = 0;
+        m_previewStatisticsTimer.start();
+
+        // Counters change with every frame, readers are told once per rate window
+        emit previewStatisticsChanged();
+    }
+}
+
+QVideoFrame::PixelFormat GPhotoCameraSession::previewPixelFormat() const
+{
+    // Only decoded lines can be cropped, raw planes and undecoded frames can't
+    if (!m_surface || !m_previewCrop.isNull())
+        return QVideoFrame::Format_RGB32;
+
+    // Surfaces accepting JPEG get live view undecoded, it's decoded only if a sink maps the frame.
+    // Planar YUV is what JPEG holds inside, so it's decoded without any colorspace conversion
+    const auto &formats = m_surface->supportedPixelFormats();
+    for (auto format : {QVideoFrame::Format_Jpeg, QVideoFrame::Format_YUV420P}) {
+        if (formats.contains(format))
+            return format;
+    }
+
+    return QVideoFrame::Format_RGB32;
+}
+
+void GPhotoCameraSession::updatePreviewFormat()
+{
+    const auto &format = previewPixelFormat();
+
+    if (const auto &controller = m_controller.lock()) {
+        // Live view is decoded right to the size viewfinder shows, invalid size means full size
+        controller->setPreviewSize(m_cameraIndex, m_previewResolution);
+        controller->setPreviewFormat(m_cameraIndex, format);
+        controller->setPreviewCrop(m_cameraIndex, m_previewCrop);
+        controller->setPreviewFrameRate(m_cameraIndex, m_previewFrameRate);
+        controller->setPreviewStatisticsEnabled(m_cameraIndex, 0 < m_probeCount);
+        controller->setPreviewFocusMeasurement(m_cameraIndex, m_focusMeasurementEnabled ? focusRegion() : QRectF(),
+                                               m_focusPeakingThreshold);
+        controller->setPreviewMotionDetection(m_cameraIndex, m_motionRegions, m_motionThreshold, m_motionCooldown);
+
+        // Camera stops fetching live view while frames stay unconsumed, resume it for a new surface or detection
+        if ((m_surface || 0 < m_motionThreshold) && 0 < m_unconsumedPreviewFrames) {
+            controller->previewConsumed(m_cameraIndex, m_unconsumedPreviewFrames);
+            m_unconsumedPreviewFrames = 0;
+        }
     }
 }
 
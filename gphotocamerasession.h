@@ -1,24 +1,51 @@
 #ifndef GPHOTOCAMERASESSION_H
 #define GPHOTOCAMERASESSION_H
 
+#include <functional>
 #include <memory>
 
 #include <QCamera>
 #include <QCameraImageCapture>
+#include <QElapsedTimer>
 #include <QObject>
 #include <QPointer>
+#include <QRectF>
+#include <QSize>
+#include <QVector>
+#include <QVideoFrame>
 
 QT_BEGIN_NAMESPACE
 class QCameraFocusControl;
 QT_END_NAMESPACE
 
 class GPhotoCamera;
+class GPhotoCameraFocusControl;
+class GPhotoCameraChannel;
 class GPhotoController;
+class GPhotoFrameExporter;
 
 class GPhotoCameraSession final : public QObject
 {
     Q_OBJECT
 public:
+    /// Live view delivery counters, latency is measured from the end of USB transfer to present()
+    struct PreviewStatistics {
+        enum { LatencyBucketCount = 8 };
+
+        /// Upper bounds of latency histogram buckets in milliseconds, the last bucket counts the rest
+        static const int latencyBounds[LatencyBucketCount - 1];
+
+        quint64 deliveredFrames = 0;
+        quint64 droppedFrames = 0;
+        /// Frames per second over the last full second
+        qreal deliveredFrameRate = 0;
+        qreal droppedFrameRate = 0;
+        quint64 latencyHistogram[LatencyBucketCount] = {};
+        qint64 lastLatency = 0;
+        qint64 maxLatency = 0;
+        qint64 totalLatency = 0;
+    };
+
     explicit GPhotoCameraSession(std::weak_ptr<GPhotoController> controller, QObject *parent = nullptr);
     ~GPhotoCameraSession();
 
@@ -26,7 +53,9 @@ public:
     GPhotoCameraSession& operator=(GPhotoCameraSession&&) = delete;
 
     QList<QByteArray> cameraNames() const;
+    void cameraNames(QObject *context, std::function<void (const QList<QByteArray> &)> callback) const;
     QByteArray defaultCameraName() const;
+    void defaultCameraName(QObject *context, std::function<void (const QByteArray &)> callback) const;
 
     // camera control
     QCamera::State state() const;
@@ -50,13 +79,65 @@ public:
     QAbstractVideoSurface* surface() const;
     void setSurface(QAbstractVideoSurface *surface);
 
+    // viewfinder settings control, zero rate means no limit
+    qreal previewFrameRate() const;
+    void setPreviewFrameRate(qreal frameRate);
+    // size live view is decoded to, invalid size means full size, see GPhotoPreviewDecoder
+    QSize previewResolution() const;
+    void setPreviewResolution(const QSize &size);
+    // region of interest relative to frame size, empty region means the whole frame, see GPhotoPreviewDecoder
+    QRectF previewCrop() const;
+    void setPreviewCrop(const QRectF &region);
+
+    // live view statistics of the current camera
+    PreviewStatistics previewStatistics() const;
+    void resetPreviewStatistics();
+
+    // live view export to other processes, see GPhotoFrameExporter
+    bool startFrameExport(const QString &name, int slotCount, int slotSize);
+    void stopFrameExport();
+    QString frameExportName() const;
+
+    // video probe control, frames are probed only while some probe is attached
+    void attachProbe();
+    void detachProbe();
+    // limits shared by all probes, zero rate and empty size mean no limit, see GPhotoVideoProbeControl
+    qreal probeFrameRate() const;
+    void setProbeFrameRate(qreal frameRate);
+    QSize probeFrameSize() const;
+    void setProbeFrameSize(const QSize &size);
+
     // options control
     QVariant parameter(const QString &name) const;
+    void parameter(const QString &name, QObject *context, std::function<void (const QVariant &)> callback) const;
     bool setParameter(const QString &name, const QVariant &value);
+    void setParameter(const QString &name, const QVariant &value,
+                      QObject *context, std::function<void (bool)> callback);
+    QVariantMap setParameters(const QVariantMap &values);
+    void setParameters(const QVariantMap &values, QObject *context,
+                       std::function<void (const QVariantMap &)> callback);
     QVariantList parameterValues(const QString &name, QMetaType::Type valueType) const;
+    void parameterValues(const QString &name, QMetaType::Type valueType,
+                         QObject *context, std::function<void (const QVariantList &)> callback) const;
+    void refreshConfig();
+    void setOperationTimeout(int timeout);
 
     QCameraFocusControl* cameraFocusControl() const;
 
+    // focus measurement, see GPhotoFocusMeasure
+    QRectF focusRegion() const;
+    void setFocusMeasurementEnabled(bool enabled);
+    int focusPeakingThreshold() const;
+    void setFocusPeakingThreshold(int threshold);
+
+    // motion triggered capture, see GPhotoMotionDetector, zero threshold turns it off
+    QVector<QRectF> motionRegions() const;
+    void setMotionRegions(const QVector<QRectF> &regions);
+    int motionThreshold() const;
+    void setMotionThreshold(int threshold);
+    int motionCooldown() const;
+    void setMotionCooldown(int msec);
+
     void setCamera(int cameraIndex);
 
 signals:
@@ -74,28 +155,48 @@ signals:
     void imageCaptured(int id, const QImage &preview);
     void imageCaptureError(int id, int errorCode, const QString &errorString);
     void imageSaved(int id, const QString &fileName);
+    // capture of a negative id was started by motion in a live view frame of the given start time
+    void motionCaptureTriggered(int id, qint64 timestamp);
     void readyForCaptureChanged(bool readyForCapture);
 
     // video probe control
     void videoFrameProbed(const QVideoFrame &frame);
 
+    // focus measurement, timestamp is start time of the measured frame
+    void focusSharpnessMeasured(qreal sharpness, qint64 timestamp);
+
+    // live view statistics, emitted with every frame rate update and on reset
+    void previewStatisticsChanged();
+
+    // options control, empty list means that any option might have changed
+    void parametersChanged(const QStringList &names);
+
 private slots:
     void onCaptureModeChanged(int cameraIndex, QCamera::CaptureModes captureMode);
     void onError(int cameraIndex, int errorCode, const QString &errorString);
     void onImageCaptureError(int cameraIndex, int id, int errorCode, const QString &errorString);
     void onImageCaptured(int cameraIndex, int id, const QByteArray &imageData,
                          const QString &format, const QString &fileName);
-    void onPreviewCaptured(int cameraIndex, const QImage &image);
+    void onMotionCaptureTriggered(int cameraIndex, int id, qint64 timestamp);
+    void onParametersChanged(int cameraIndex, const QStringList &names);
+    void onPreviewCaptured(int cameraIndex, const QVideoFrame &frame);
     void onReadyForCaptureChanged(int cameraIndex, bool readyForCapture);
     void onStateChanged(int cameraIndex, QCamera::State state);
     void onStatusChanged(int cameraIndex, QCamera::Status status);
+    void updatePreviewFormat();
 
 private:
     Q_DISABLE_COPY(GPhotoCameraSession)
 
+    void subscribe(GPhotoCameraChannel *channel);
+    QVideoFrame::PixelFormat previewPixelFormat() const;
+    void updatePreviewStatistics(const QVideoFrame &frame, bool presented);
+
     std::weak_ptr<GPhotoController> m_controller;
-    std::unique_ptr<QCameraFocusControl> m_cameraFocusControl;
+    std::unique_ptr<GPhotoCameraFocusControl> m_cameraFocusControl;
     QPointer<QAbstractVideoSurface> m_surface;
+    QPointer<GPhotoCameraChannel> m_channel;
+    std::unique_ptr<GPhotoFrameExporter> m_frameExporter;
 
     QCamera::CaptureModes m_captureMode = QCamera::CaptureStillImage;
     QCamera::State m_state = QCamera::UnloadedState;
@@ -106,6 +207,25 @@ private:
 
     int m_cameraIndex = -1;
     int m_captureId = 0;
+    int m_unconsumedPreviewFrames = 0;
+    int m_probeCount = 0;
+    qreal m_probeFrameRate = 0;
+    QSize m_probeFrameSize;
+    int m_focusPeakingThreshold = 0;
+    QVector<QRectF> m_motionRegions;
+    int m_motionThreshold = 0;
+    int m_motionCooldown;
+    bool m_focusMeasurementEnabled = false;
+    qreal m_previewFrameRate = 0;
+    QSize m_previewResolution;
+    QRectF m_previewCrop;
+
+    PreviewStatistics m_previewStatistics;
+    QElapsedTimer m_previewStatisticsTimer;
+    quint64 m_lastPreviewSequence = 0;
+    quint64 m_windowDeliveredFrames = 0;
+    quint64 m_windowDroppedFrames = 0;
+    bool m_previewSequenceKnown = false;
     bool m_readyForCapture = false;
 };
 
@@ -2,11 +2,13 @@
 #include <QDebug>
 #include <QEventLoop>
 #include <QFile>
+#include <QPointer>
 #include <QStandardPaths>
 #include <QThread>
 #include <QVideoSurfaceFormat>
 
 #include "gphotocamera.h"
+#include "gphotocamerachannel.h"
 #include "gphotocontroller.h"
 #include "gphotoworker.h"
 
@@ -21,12 +23,17 @@ GPhotoController::GPhotoController(QObject *parent)
 {
     m_worker->moveToThread(m_workerThread.get());
 
+    // Motion detection regions are passed to the worker thread by queued calls
+    qRegisterMetaType<QVector<QRectF>>();
+
     connect(m_worker.get(), &GPhotoWorker::captureModeChanged, this, &GPhotoController::onCaptureModeChanged);
-    connect(m_worker.get(), &GPhotoWorker::error, this, &GPhotoController::error);
-    connect(m_worker.get(), &GPhotoWorker::imageCaptureError, this, &GPhotoController::imageCaptureError);
-    connect(m_worker.get(), &GPhotoWorker::imageCaptured, this, &GPhotoController::imageCaptured);
-    connect(m_worker.get(), &GPhotoWorker::previewCaptured, this, &GPhotoController::previewCaptured);
-    connect(m_worker.get(), &GPhotoWorker::readyForCaptureChanged, this, &GPhotoController::readyForCaptureChanged);
+    connect(m_worker.get(), &GPhotoWorker::error, this, &GPhotoController::onError);
+    connect(m_worker.get(), &GPhotoWorker::imageCaptureError, this, &GPhotoController::onImageCaptureError);
+    connect(m_worker.get(), &GPhotoWorker::imageCaptured, this, &GPhotoController::onImageCaptured);
+    connect(m_worker.get(), &GPhotoWorker::motionCaptureTriggered, this, &GPhotoController::onMotionCaptureTriggered);
+    connect(m_worker.get(), &GPhotoWorker::parametersChanged, this, &GPhotoController::onParametersChanged);
+    connect(m_worker.get(), &GPhotoWorker::previewCaptured, this, &GPhotoController::onPreviewCaptured);
+    connect(m_worker.get(), &GPhotoWorker::readyForCaptureChanged, this, &GPhotoController::onReadyForCaptureChanged);
     connect(m_worker.get(), &GPhotoWorker::stateChanged, this, &GPhotoController::onStateChanged);
     connect(m_worker.get(), &GPhotoWorker::statusChanged, this, &GPhotoController::onStatusChanged);
 
@@ -41,6 +48,25 @@ GPhotoController::~GPhotoController()
         m_workerThread->terminate();
 }
 
+template <typename T>
+void GPhotoController::invokeAsync(std::function<T (GPhotoWorker*)> request, QObject *context,
+                                   Callback<T> callback) const
+{
+    // Result is passed back through controller which outlives the worker thread,
+    // so the context object is only checked in its own thread
+    auto controller = const_cast<GPhotoController*>(this);
+    auto worker = m_worker.get();
+    auto guard = QPointer<QObject>(context);
+
+    QMetaObject::invokeMethod(worker, [controller, worker, request, guard, callback] {
+        auto result = request(worker);
+        QMetaObject::invokeMethod(controller, [guard, callback, result] {
+            if (guard && callback)
+                callback(result);
+        }, Qt::QueuedConnection);
+    }, Qt::QueuedConnection);
+}
+
 bool GPhotoController::init()
 {
     auto result = false;
@@ -49,6 +75,21 @@ bool GPhotoController::init()
     return result;
 }
 
+GPhotoCameraChannel* GPhotoController::channel(int cameraIndex)
+{
+    auto &channel = m_channels[cameraIndex];
+    if (!channel)
+        channel.reset(new GPhotoCameraChannel);
+
+    return channel.get();
+}
+
+GPhotoCameraChannel* GPhotoController::findChannel(int cameraIndex) const
+{
+    auto it = m_channels.find(cameraIndex);
+    return (m_channels.cend() != it) ? it->second.get() : nullptr;
+}
+
 QList<QByteArray> GPhotoController::cameraNames() const
 {
     QList<QByteArray> result;
@@ -57,6 +98,13 @@ QList<QByteArray> GPhotoController::cameraNames() const
     return result;
 }
 
+void GPhotoController::cameraNames(QObject *context, Callback<QList<QByteArray>> callback) const
+{
+    invokeAsync<QList<QByteArray>>([] (GPhotoWorker *worker) {
+        return worker->cameraNames();
+    }, context, std::move(callback));
+}
+
 QByteArray GPhotoController::defaultCameraName() const
 {
     QByteArray result;
@@ -65,6 +113,13 @@ QByteArray GPhotoController::defaultCameraName() const
     return result;
 }
 
+void GPhotoController::defaultCameraName(QObject *context, Callback<QByteArray> callback) const
+{
+    invokeAsync<QByteArray>([] (GPhotoWorker *worker) {
+        return worker->defaultCameraName();
+    }, context, std::move(callback));
+}
+
 void GPhotoController::capturePhoto(int cameraIndex, int id, const QString &fileName) const
 {
     QMetaObject::invokeMethod(m_worker.get(), "capturePhoto", Qt::QueuedConnection,
@@ -106,6 +161,14 @@ QVariant GPhotoController::parameter(int cameraIndex, const QString &name) const
     return result;
 }
 
+void GPhotoController::parameter(int cameraIndex, const QString &name, QObject *context,
+                                 Callback<QVariant> callback) const
+{
+    invokeAsync<QVariant>([cameraIndex, name] (GPhotoWorker *worker) {
+        return worker->parameter(cameraIndex, name);
+    }, context, std::move(callback));
+}
+
 bool GPhotoController::setParameter(int cameraIndex, const QString &name, const QVariant &value)
 {
     auto result = false;
@@ -115,6 +178,31 @@ bool GPhotoController::setParameter(int cameraIndex, const QString &name, const
     return result;
 }
 
+void GPhotoController::setParameter(int cameraIndex, const QString &name, const QVariant &value,
+                                    QObject *context, Callback<bool> callback)
+{
+    invokeAsync<bool>([cameraIndex, name, value] (GPhotoWorker *worker) {
+        return worker->setParameter(cameraIndex, name, value);
+    }, context, std::move(callback));
+}
+
+QVariantMap GPhotoController::setParameters(int cameraIndex, const QVariantMap &values)
+{
+    QVariantMap result;
+    QMetaObject::invokeMethod(m_worker.get(), "setParameters", Qt::BlockingQueuedConnection,
+                              Q_RETURN_ARG(QVariantMap, result), Q_ARG(int, cameraIndex),
+                              Q_ARG(QVariantMap, values));
+    return result;
+}
+
+void GPhotoController::setParameters(int cameraIndex, const QVariantMap &values, QObject *context,
+                                     Callback<QVariantMap> callback)
+{
+    invokeAsync<QVariantMap>([cameraIndex, values] (GPhotoWorker *worker) {
+        return worker->setParameters(cameraIndex, values);
+    }, context, std::move(callback));
+}
+
 QVariantList GPhotoController::parameterValues(int cameraIndex, const QString &name, QMetaType::Type valueType) const
 {
     auto result = QVariantList();
@@ -124,19 +212,133 @@ QVariantList GPhotoController::parameterValues(int cameraIndex, const QString &n
     return result;
 }
 
+void GPhotoController::parameterValues(int cameraIndex, const QString &name, QMetaType::Type valueType,
+                                       QObject *context, Callback<QVariantList> callback) const
+{
+    invokeAsync<QVariantList>([cameraIndex, name, valueType] (GPhotoWorker *worker) {
+        return worker->parameterValues(cameraIndex, name, valueType);
+    }, context, std::move(callback));
+}
+
+void GPhotoController::refreshConfig(int cameraIndex) const
+{
+    QMetaObject::invokeMethod(m_worker.get(), "refreshConfig", Qt::QueuedConnection, Q_ARG(int, cameraIndex));
+}
+
+void GPhotoController::setOperationTimeout(int cameraIndex, int timeout) const
+{
+    QMetaObject::invokeMethod(m_worker.get(), "setOperationTimeout", Qt::QueuedConnection,
+                              Q_ARG(int, cameraIndex), Q_ARG(int, timeout));
+}
+
+void GPhotoController::setPreviewSize(int cameraIndex, const QSize &size) const
+{
+    QMetaObject::invokeMethod(m_worker.get(), "setPreviewSize", Qt::QueuedConnection,
+                              Q_ARG(int, cameraIndex), Q_ARG(QSize, size));
+}
+
+void GPhotoController::setPreviewFormat(int cameraIndex, QVideoFrame::PixelFormat format) const
+{
+    QMetaObject::invokeMethod(m_worker.get(), "setPreviewFormat", Qt::QueuedConnection,
+                              Q_ARG(int, cameraIndex), Q_ARG(QVideoFrame::PixelFormat, format));
+}
+
+void GPhotoController::setPreviewCrop(int cameraIndex, const QRectF &region) const
+{
+    QMetaObject::invokeMethod(m_worker.get(), "setPreviewCrop", Qt::QueuedConnection,
+                              Q_ARG(int, cameraIndex), Q_ARG(QRectF, region));
+}
+
+void GPhotoController::setPreviewFrameRate(int cameraIndex, qreal frameRate) const
+{
+    QMetaObject::invokeMethod(m_worker.get(), "setPreviewFrameRate", Qt::QueuedConnection,
+                              Q_ARG(int, cameraIndex), Q_ARG(qreal, frameRate));
+}
+
+void GPhotoController::setPreviewStatisticsEnabled(int cameraIndex, bool enabled) const
+{
+    QMetaObject::invokeMethod(m_worker.get(), "setPreviewStatisticsEnabled", Qt::QueuedConnection,
+                              Q_ARG(int, cameraIndex), Q_ARG(bool, enabled));
+}
+
+void GPhotoController::setPreviewFocusMeasurement(int cameraIndex, const QRectF &region, int peakingThreshold) const
+{
+    QMetaObject::invokeMethod(m_worker.get(), "setPreviewFocusMeasurement", Qt::QueuedConnection,
+                              Q_ARG(int, cameraIndex), Q_ARG(QRectF, region), Q_ARG(int, peakingThreshold));
+}
+
+void GPhotoController::setPreviewMotionDetection(int cameraIndex, const QVector<QRectF> &regions,
+                                                 int threshold, int cooldown) const
+{
+    QMetaObject::invokeMethod(m_worker.get(), "setPreviewMotionDetection", Qt::QueuedConnection,
+                              Q_ARG(int, cameraIndex), Q_ARG(QVector<QRectF>, regions),
+                              Q_ARG(int, threshold), Q_ARG(int, cooldown));
+}
+
+void GPhotoController::previewConsumed(int cameraIndex, int count) const
+{
+    QMetaObject::invokeMethod(m_worker.get(), "previewConsumed", Qt::QueuedConnection,
+                              Q_ARG(int, cameraIndex), Q_ARG(int, count));
+}
+
 void GPhotoController::onCaptureModeChanged(int cameraIndex, QCamera::CaptureModes captureMode)
 {
     if (m_captureModes.value(cameraIndex, QCamera::CaptureStillImage) != captureMode) {
         m_captureModes[cameraIndex] = captureMode;
-        emit captureModeChanged(cameraIndex, captureMode);
+        if (auto channel = findChannel(cameraIndex))
+            emit channel->captureModeChanged(cameraIndex, captureMode);
     }
 }
 
+void GPhotoController::onError(int cameraIndex, int errorCode, const QString &errorString)
+{
+    if (auto channel = findChannel(cameraIndex))
+        emit channel->error(cameraIndex, errorCode, errorString);
+}
+
+void GPhotoController::onImageCaptureError(int cameraIndex, int id, int errorCode, const QString &errorString)
+{
+    if (auto channel = findChannel(cameraIndex))
+        emit channel->imageCaptureError(cameraIndex, id, errorCode, errorString);
+}
+
+void GPhotoController::onImageCaptured(int cameraIndex, int id, const QByteArray &imageData,
+                                       const QString &format, const QString &fileName)
+{
+    if (auto channel = findChannel(cameraIndex))
+        emit channel->imageCaptured(cameraIndex, id, imageData, format, fileName);
+}
+
+void GPhotoController::onMotionCaptureTriggered(int cameraIndex, int id, qint64 timestamp)
+{
+    if (auto channel = findChannel(cameraIndex))
+        emit channel->motionCaptureTriggered(cameraIndex, id, timestamp);
+}
+
+void GPhotoController::onParametersChanged(int cameraIndex, const QStringList &names)
+{
+    if (auto channel = findChannel(cameraIndex))
+        emit channel->parametersChanged(cameraIndex, names);
+}
+
+void GPhotoController::onPreviewCaptured(int cameraIndex, const QVideoFrame &frame)
+{
+    if (auto channel = findChannel(cameraIndex))
+        emit channel->previewCaptured(cameraIndex, frame);
+}
+
+void GPhotoController::onReadyForCaptureChanged(int cameraIndex, bool readyForCapture)
+{
+    if (auto channel = findChannel(cameraIndex))
+        emit channel->readyForCaptureChanged(cameraIndex, readyForCapture);
+}
+
 void GPhotoController::onStateChanged(int cameraIndex, QCamera::State state)
 {
     if (m_states.value(cameraIndex, QCamera::UnloadedState) != state) {
         m_states[cameraIndex] = state;
-        emit stateChanged(cameraIndex, state);
+        if (auto channel = findChannel(cameraIndex))
+            emit channel->stateChanged(cameraIndex, state);
     }
 }
 
@@ -144,6 +346,7 @@ void GPhotoController::onStatusChanged(int cameraIndex, QCamera::Status status)
 {
     if (m_statuses.value(cameraIndex, QCamera::UnloadedStatus) != status) {
         m_statuses[cameraIndex] = status;
-        emit statusChanged(cameraIndex, status);
+        if (auto channel = findChannel(cameraIndex))
+            emit channel->statusChanged(cameraIndex, status);
     }
 }
@@ -1,22 +1,37 @@
 #ifndef GPHOTOCONTROLLER_H
 #define GPHOTOCONTROLLER_H
 
+#include <functional>
+#include <map>
 #include <memory>
 
 #include <QCamera>
 #include <QObject>
+#include <QRectF>
+#include <QVector>
+#include <QVideoFrame>
 
 QT_BEGIN_NAMESPACE
 class QThread;
 QT_END_NAMESPACE
 
 class GPhotoCamera;
+class GPhotoCameraChannel;
 class GPhotoWorker;
 
+/** Bridge between sessions in the GUI thread and the camera worker thread.
+ *
+ * Requests are queued to the worker, notifications come back through the
+ * channel of the camera they belong to, see channel().
+ */
 class GPhotoController final : public QObject
 {
     Q_OBJECT
 public:
+    /// Completion callback of asynchronous requests, it's called in controller thread while context object is alive
+    template <typename T>
+    using Callback = std::function<void (const T &)>;
+
     explicit GPhotoController(QObject *parent = nullptr);
     ~GPhotoController();
 
@@ -25,8 +40,13 @@ public:
 
     bool init();
 
+    /// Notifications of the camera, the channel lives as long as controller
+    GPhotoCameraChannel* channel(int cameraIndex);
+
     QList<QByteArray> cameraNames() const;
+    void cameraNames(QObject *context, Callback<QList<QByteArray>> callback) const;
     QByteArray defaultCameraName() const;
+    void defaultCameraName(QObject *context, Callback<QByteArray> callback) const;
 
     void capturePhoto(int cameraIndex, int id, const QString &fileName) const;
 
@@ -39,28 +59,47 @@ public:
     QCamera::Status status(int cameraIndex) const;
 
     QVariant parameter(int cameraIndex, const QString &name) const;
+    void parameter(int cameraIndex, const QString &name, QObject *context, Callback<QVariant> callback) const;
     bool setParameter(int cameraIndex, const QString &name, const QVariant &value);
+    void setParameter(int cameraIndex, const QString &name, const QVariant &value,
+                      QObject *context, Callback<bool> callback);
+    QVariantMap setParameters(int cameraIndex, const QVariantMap &values);
+    void setParameters(int cameraIndex, const QVariantMap &values, QObject *context, Callback<QVariantMap> callback);
     QVariantList parameterValues(int cameraIndex, const QString &name, QMetaType::Type valueType) const;
-
-signals:
-    void captureModeChanged(int cameraIndex, QCamera::CaptureModes);
-    void error(int cameraIndex, int errorCode, const QString &errorString);
-    void imageCaptured(int cameraIndex, int id, const QByteArray &imageData,
-                       const QString &format, const QString &fileName);
-    void imageCaptureError(int cameraIndex, int id, int errorCode, const QString &errorString);
-    void previewCaptured(int cameraIndex, const QImage &image);
-    void readyForCaptureChanged(int cameraIndex, bool);
-    void stateChanged(int cameraIndex, QCamera::State);
-    void statusChanged(int cameraIndex, QCamera::Status);
+    void parameterValues(int cameraIndex, const QString &name, QMetaType::Type valueType,
+                         QObject *context, Callback<QVariantList> callback) const;
+    void refreshConfig(int cameraIndex) const;
+    void setOperationTimeout(int cameraIndex, int timeout) const;
+    void setPreviewSize(int cameraIndex, const QSize &size) const;
+    void setPreviewFormat(int cameraIndex, QVideoFrame::PixelFormat format) const;
+    void setPreviewCrop(int cameraIndex, const QRectF &region) const;
+    void setPreviewFrameRate(int cameraIndex, qreal frameRate) const;
+    void setPreviewStatisticsEnabled(int cameraIndex, bool enabled) const;
+    void setPreviewFocusMeasurement(int cameraIndex, const QRectF &region, int peakingThreshold) const;
+    void setPreviewMotionDetection(int cameraIndex, const QVector<QRectF> &regions, int threshold, int cooldown) const;
+    void previewConsumed(int cameraIndex, int count) const;
 
 private slots:
     void onCaptureModeChanged(int cameraIndex, QCamera::CaptureModes captureMode);
+    void onError(int cameraIndex, int errorCode, const QString &errorString);
+    void onImageCaptureError(int cameraIndex, int id, int errorCode, const QString &errorString);
+    void onImageCaptured(int cameraIndex, int id, const QByteArray &imageData,
+                         const QString &format, const QString &fileName);
+    void onMotionCaptureTriggered(int cameraIndex, int id, qint64 timestamp);
+    void onParametersChanged(int cameraIndex, const QStringList &names);
+    void onPreviewCaptured(int cameraIndex, const QVideoFrame &frame);
+    void onReadyForCaptureChanged(int cameraIndex, bool readyForCapture);
     void onStateChanged(int cameraIndex, QCamera::State state);
     void onStatusChanged(int cameraIndex, QCamera::Status status);
 
 private:
     Q_DISABLE_COPY(GPhotoController)
 
+    template <typename T>
+    void invokeAsync(std::function<T (GPhotoWorker*)> request, QObject *context, Callback<T> callback) const;
+
+    GPhotoCameraChannel* findChannel(int cameraIndex) const;
+
     std::unique_ptr<QThread> m_workerThread;
     std::unique_ptr<GPhotoWorker> m_worker;
 
@@ -68,6 +107,8 @@ private:
     QMap<int, QCamera::State> m_states;
     QMap<int, QCamera::Status> m_statuses;
     QMap<int, bool> m_capturings;
+
+    std::map<int, std::unique_ptr<GPhotoCameraChannel>> m_channels;
 };
 
 #endif // GPHOTOCONTROLLER_H
@@ -17,41 +17,14 @@ GPhotoExposureControl::GPhotoExposureControl(GPhotoCameraSession *session, QObje
     using Session = GPhotoCameraSession;
     using Control = GPhotoExposureControl;
 
+    connect(m_session, &Session::parametersChanged, this, &Control::parametersChanged);
     connect(m_session, &Session::stateChanged, this, &Control::stateChanged);
 }
 
 QVariant GPhotoExposureControl::actualValue(QCameraExposureControl::ExposureParameter parameter) const
 {
-    if (QCamera::UnloadedState == m_state)
-        return QVariant();
-
-    if (Aperture == parameter) {
-        const auto &value = m_session->parameter(QLatin1String(apertureParameter));
-        auto ok = false;
-        // We use a workaround for flawed russian i18n of gphoto2 strings
-        const auto &aperture = value.toString().replace(',', '.').toDouble(&ok);
-        return ok ? QVariant(aperture) : QVariant();
-    }
-
-    if (ExposureCompensation == parameter) {
-        const auto &value = m_session->parameter(QLatin1String(exposureCompensationParameter));
-        auto ok = false;
-        // We use a workaround for flawed russian i18n of gphoto2 strings
-        const auto &exposure = value.toString().replace(',', '.').toDouble(&ok);
-        return ok ? QVariant(exposure) : QVariant();
-    }
-
-    if (ISO == parameter) {
-        auto ok = false;
-        const auto &iso = m_session->parameter(QLatin1String(isoParameter)).toInt(&ok);
-        // Invalid QVariant for Auto ISO
-        return ok ? QVariant(iso) : QVariant();
-    }
-
-    if (ShutterSpeed == parameter)
-        return convertShutterSpeed(m_session->parameter(QLatin1String(shutterSpeedParameter)).toString());
-
-    return QVariant();
+    // Values are cached, so bindings don't wait for the worker on every read
+    return m_actualValues.value(parameter);
 }
 
 bool GPhotoExposureControl::isParameterSupported(QCameraExposureControl::ExposureParameter parameter) const
@@ -99,52 +72,34 @@ bool GPhotoExposureControl::setValue(QCameraExposureControl::ExposureParameter p
     if (QCamera::UnloadedState == m_state)
         return false;
 
-    if (Aperture == parameter) {
-        if (m_session->setParameter(QLatin1String(apertureParameter), value)) {
-            emit actualValueChanged(parameter);
-            return true;
-        }
-    } else if (ExposureCompensation == parameter) {
-        if (m_session->setParameter(QLatin1String(exposureCompensationParameter), value)) {
-            emit actualValueChanged(parameter);
-            return true;
-        }
-    } else if (ISO == parameter) {
-        QVariant v = value;
-        if (!v.isValid())
-            v = -1;
-        if (m_session->setParameter(QLatin1String(isoParameter), v)) {
-            emit actualValueChanged(parameter);
-            return true;
-        }
-    } else if (ShutterSpeed == parameter) {
-        if (QVariant::Double == value.type())  {
-            const auto &values = m_session->parameterValues(QLatin1String(shutterSpeedParameter), QMetaType::QString);
-            const auto &speeds = convertShutterSpeeds(values, false);
-            if (values.size() == speeds.size()) {
-                auto speed = value.toDouble();
-                const auto &found = std::find_if(speeds.cbegin(), speeds.cend(), [speed] (const QVariant &val)
-                {
-                    return qFuzzyCompare(speed, val.toDouble());
-                });
-
-                if (speeds.cend() != found) {
-                    auto index = int(std::distance(speeds.cbegin(), found));
-                    if (0 <= index) {
-                        const auto &value = values.value(index);
-                        if (m_session->setParameter(QLatin1String(shutterSpeedParameter), value)) {
-                            emit actualValueChanged(parameter);
-                            return true;
-                        }
-                    }
-                }
-            }
-        }
-    } else {
+    const auto &name = parameterName(parameter);
+    if (name.isEmpty()) {
         qWarning() << "GPhoto: Currently unsupported parameter" << parameter << "change requested";
+        return false;
     }
 
-    return false;
+    const auto &cameraValue = toCameraValue(parameter, value);
+    if (!cameraValue.isValid())
+        return false;
+
+    m_session->setParameter(name, cameraValue, this, [this, parameter] (bool ok) {
+        if (QCamera::UnloadedState == m_state)
+            return;
+
+        // Camera picks the nearest supported value, so read back what was actually set
+        if (ok) {
+            updateActualValue(parameter);
+            return;
+        }
+
+        // Camera kept the previous value, requested one goes back to it so UI doesn't show rejected value
+        qWarning() << "GPhoto: Camera rejected" << parameterName(parameter) << "value";
+        m_requestedValues[parameter] = m_actualValues.value(parameter);
+        emit requestedValueChanged(parameter);
+        emit actualValueChanged(parameter);
+    });
+
+    return true;
 }
 
 QVariantList GPhotoExposureControl::supportedParameterRange(QCameraExposureControl::ExposureParameter parameter, bool *continuous) const
@@ -152,17 +107,22 @@ QVariantList GPhotoExposureControl::supportedParameterRange(QCameraExposureContr
     if (nullptr != continuous)
         *continuous = false;
 
-    switch (parameter) {
-    case Aperture:
-        return m_session->parameterValues(QLatin1String(apertureParameter), QMetaType::Double);
-    case ExposureCompensation:
-        return m_session->parameterValues(QLatin1String(exposureCompensationParameter), QMetaType::Double);
-    case ISO:
-        return m_session->parameterValues(QLatin1String(isoParameter), QMetaType::Int);
-    case ShutterSpeed:
-        return convertShutterSpeeds(m_session->parameterValues(QLatin1String(shutterSpeedParameter), QMetaType::QString));
-    default:
-        return {};
+    return m_parameterRanges.value(parameter);
+}
+
+void GPhotoExposureControl::parametersChanged(const QStringList &names)
+{
+    if (QCamera::UnloadedState == m_state)
+        return;
+
+    for (auto p : {Aperture, ExposureCompensation, ISO, ShutterSpeed}) {
+        // Empty list means that camera config was reloaded completely, ranges might change too
+        if (names.isEmpty()) {
+            updateParameterRange(p);
+            updateActualValue(p);
+        } else if (names.contains(parameterName(p))) {
+            updateActualValue(p);
+        }
     }
 }
 
@@ -172,25 +132,136 @@ void GPhotoExposureControl::stateChanged(QCamera::State state)
         if (QCamera::UnloadedState == m_state && QCamera::LoadedState == state) {
             m_state = state;
 
+            QVariantMap values;
+            QMap<QString, ExposureParameter> requested;
+
             static const auto &parameter = metaObject()->enumerator(metaObject()->indexOfEnumerator("ExposureParameter"));
             for (auto i = 0; i < parameter.keyCount(); ++i) {
                 auto p = ExposureParameter(parameter.value(i));
 
                 if (isParameterSupported(p)) {
-                    // Set all parameters requested on start to session object
-                    if (m_requestedValues.contains(p))
-                        setValue(p, m_requestedValues.value(p));
-                    // or just notify frontend that it's allowed to get the parameter values from backend
-                    else
-                        emit actualValueChanged(p);
+                    updateParameterRange(p);
+
+                    // Collect all parameters requested on start to set them to session object at once
+                    if (m_requestedValues.contains(p)) {
+                        const auto &value = toCameraValue(p, m_requestedValues.value(p));
+                        if (value.isValid()) {
+                            values.insert(parameterName(p), value);
+                            requested.insert(parameterName(p), p);
+                            continue;
+                        }
+                    }
+
+                    // or just fetch the current value from backend
+                    updateActualValue(p);
                 }
             }
+
+            if (!values.isEmpty()) {
+                m_session->setParameters(values, this, [this, requested] (const QVariantMap &) {
+                    // Read values back even for failed writes, the cache must reflect the camera
+                    for (auto p : requested)
+                        updateActualValue(p);
+                });
+            }
         } else {
             m_state = state;
+
+            if (QCamera::UnloadedState == state) {
+                m_actualValues.clear();
+                m_parameterRanges.clear();
+            }
         }
     }
 }
 
+void GPhotoExposureControl::updateActualValue(QCameraExposureControl::ExposureParameter parameter)
+{
+    m_session->parameter(parameterName(parameter), this, [this, parameter] (const QVariant &value) {
+        // Camera may be closed while request was in progress
+        if (QCamera::UnloadedState == m_state)
+            return;
+
+        const auto &actualValue = fromCameraValue(parameter, value);
+        if (m_actualValues.contains(parameter) && m_actualValues.value(parameter) == actualValue)
+            return;
+
+        m_actualValues.insert(parameter, actualValue);
+        emit actualValueChanged(parameter);
+    });
+}
+
+void GPhotoExposureControl::updateParameterRange(QCameraExposureControl::ExposureParameter parameter)
+{
+    auto valueType = (ISO == parameter) ? QMetaType::Int : QMetaType::Double;
+
+    m_session->parameterValues(parameterName(parameter), valueType, this, [this, parameter] (const QVariantList &values) {
+        if (QCamera::UnloadedState == m_state)
+            return;
+
+        if (m_parameterRanges.contains(parameter) && m_parameterRanges.value(parameter) == values)
+            return;
+
+        m_parameterRanges.insert(parameter, values);
+        emit parameterRangeChanged(parameter);
+    });
+}
+
+QString GPhotoExposureControl::parameterName(QCameraExposureControl::ExposureParameter parameter)
+{
+    switch (parameter) {
+    case Aperture:
+        return QLatin1String(apertureParameter);
+    case ExposureCompensation:
+        return QLatin1String(exposureCompensationParameter);
+    case ISO:
+        return QLatin1String(isoParameter);
+    case ShutterSpeed:
+        return QLatin1String(shutterSpeedParameter);
+    default:
+        return QString();
+    }
+}
+
+QVariant GPhotoExposureControl::toCameraValue(QCameraExposureControl::ExposureParameter parameter,
+                                              const QVariant &value)
+{
+    if (ISO == parameter) {
+        // Invalid QVariant means Auto ISO
+        return value.isValid() ? value : QVariant(-1);
+    }
+
+    if (ShutterSpeed == parameter) {
+        // Camera matches the nearest shutter speed choice by itself
+        return (QVariant::Double == value.type()) ? value : QVariant();
+    }
+
+    return value;
+}
+
+QVariant GPhotoExposureControl::fromCameraValue(QCameraExposureControl::ExposureParameter parameter,
+                                                const QVariant &value)
+{
+    if (Aperture == parameter || ExposureCompensation == parameter) {
+        auto ok = false;
+        // We use a workaround for flawed russian i18n of gphoto2 strings
+        const auto &result = value.toString().replace(',', '.').toDouble(&ok);
+        return ok ? QVariant(result) : QVariant();
+    }
+
+    if (ISO == parameter) {
+        auto ok = false;
+        const auto &iso = value.toInt(&ok);
+        // Invalid QVariant for Auto ISO
+        return ok ? QVariant(iso) : QVariant();
+    }
+
+    if (ShutterSpeed == parameter)
+        return convertShutterSpeed(value.toString());
+
+    return QVariant();
+}
+
 QVariant GPhotoExposureControl::convertShutterSpeed(const QVariant &value)
 {
     Q_ASSERT(QVariant::String == value.type());
@@ -226,16 +297,3 @@ QVariant GPhotoExposureControl::convertShutterSpeed(const QVariant &value)
     // Invalid QVariant for auto shutter speed
     return ok ? QVariant(result) : QVariant();
 }
-
-QVariantList GPhotoExposureControl::convertShutterSpeeds(const QVariantList &values, bool removeInvalids)
-{
-    auto result = QVariantList();
-
-    for (const auto &value : values) {
-        const auto &val = convertShutterSpeed(value);
-        if (val.isValid() || !removeInvalids)
-            result.append(val);
-    }
-
-    return result;
-}
@@ -22,16 +22,25 @@ public:
     QVariantList supportedParameterRange(ExposureParameter parameter, bool *continuous) const final;
 
 private slots:
+    void parametersChanged(const QStringList &names);
     void stateChanged(QCamera::State);
 
 private:
     Q_DISABLE_COPY(GPhotoExposureControl)
 
+    static QString parameterName(ExposureParameter parameter);
+    static QVariant toCameraValue(ExposureParameter parameter, const QVariant &value);
+    static QVariant fromCameraValue(ExposureParameter parameter, const QVariant &value);
+
+    void updateActualValue(ExposureParameter parameter);
+    void updateParameterRange(ExposureParameter parameter);
+
     static QVariant convertShutterSpeed(const QVariant &value);
-    static QVariantList convertShutterSpeeds(const QVariantList &values, bool removeInvalids = true);
 
     GPhotoCameraSession *const m_session;
     QMap<QCameraExposureControl::ExposureParameter, QVariant> m_requestedValues;
+    QMap<QCameraExposureControl::ExposureParameter, QVariant> m_actualValues;
+    QMap<QCameraExposureControl::ExposureParameter, QVariantList> m_parameterRanges;
 
     QCamera::State m_state;
 };
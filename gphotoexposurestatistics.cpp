@@ -0,0 +1,107 @@
+#include "gphotoexposurestatistics.h"
+#include "gphotokernels.h"
+
+const char *const GPhotoExposureStatistics::metaDataKey = "exposureStatistics";
+const int GPhotoExposureStatistics::maxSampledLines = 240;
+
+namespace {
+    constexpr auto binCount = 256;
+    constexpr auto clippingBins = 3;
+
+    QVector<int> toVector(const quint32 *histogram)
+    {
+        QVector<int> result(binCount);
+        for (auto i = 0; i < binCount; ++i)
+            result[i] = int(histogram[i]);
+        return result;
+    }
+}
+
+GPhotoExposureStatistics GPhotoExposureStatistics::analyze(const QVideoFrame &frame)
+{
+    GPhotoExposureStatistics result;
+
+    const auto format = frame.pixelFormat();
+    if (QVideoFrame::Format_RGB32 != format && QVideoFrame::Format_YUV420P != format)
+        return result;
+
+    // Mapping doesn't change the frame, a copy shares the same buffer
+    QVideoFrame source(frame);
+    if (!source.map(QAbstractVideoBuffer::ReadOnly))
+        return result;
+
+    const auto width = source.width();
+    const auto height = source.height();
+    const auto lineStep = qMax(1, height / maxSampledLines);
+
+    quint32 red[binCount] = {};
+    quint32 green[binCount] = {};
+    quint32 blue[binCount] = {};
+    quint32 luma[binCount] = {};
+    quint64 zoneSums[ZoneRows * ZoneColumns] = {};
+    quint64 zoneCounts[ZoneRows * ZoneColumns] = {};
+
+    // Zones start at even columns, so chroma of 4:2:0 frames stays aligned
+    int zoneStarts[ZoneColumns + 1];
+    for (auto i = 0; i < ZoneColumns; ++i)
+        zoneStarts[i] = (width * i / ZoneColumns) & ~1;
+    zoneStarts[ZoneColumns] = width;
+
+    for (auto y = 0; y < height; y += lineStep) {
+        const auto zoneRow = y * ZoneRows / height;
+
+        for (auto column = 0; column < ZoneColumns; ++column) {
+            const auto begin = zoneStarts[column];
+            const auto count = zoneStarts[column + 1] - begin;
+            const auto zone = zoneRow * ZoneColumns + column;
+
+            if (QVideoFrame::Format_RGB32 == format) {
+                const auto *line = source.bits() + y * source.bytesPerLine() + begin * 4;
+                zoneSums[zone] += GPhotoKernels::histogramRgb32(line, count, red, green, blue, luma);
+            } else {
+                const auto *line = source.bits(0) + y * source.bytesPerLine(0) + begin;
+                const auto *u = source.bits(1) + y / 2 * source.bytesPerLine(1) + begin / 2;
+                const auto *v = source.bits(2) + y / 2 * source.bytesPerLine(2) + begin / 2;
+                zoneSums[zone] += GPhotoKernels::histogramLuma(line, count, luma);
+                GPhotoKernels::histogramYuv420(line, u, v, count, red, green, blue);
+            }
+
+            zoneCounts[zone] += quint64(count);
+        }
+    }
+
+    source.unmap();
+
+    quint64 pixels = 0;
+    quint64 sum = 0;
+    for (auto i = 0; i < binCount; ++i) {
+        pixels += luma[i];
+        sum += quint64(i) * luma[i];
+    }
+
+    if (0 == pixels)
+        return result;
+
+    result.redHistogram = toVector(red);
+    result.greenHistogram = toVector(green);
+    result.blueHistogram = toVector(blue);
+    result.lumaHistogram = toVector(luma);
+    result.sampledPixels = int(pixels);
+    result.meanLuma = qreal(sum) / pixels;
+
+    for (auto i = 0; i < clippingBins; ++i) {
+        result.underexposedPixels += int(luma[i]);
+        result.overexposedPixels += int(luma[binCount - 1 - i]);
+    }
+
+    result.zoneLuma.reserve(ZoneRows * ZoneColumns);
+    for (auto i = 0; i < ZoneRows * ZoneColumns; ++i)
+        result.zoneLuma.append(zoneCounts[i] ? qreal(zoneSums[i]) / zoneCounts[i] : 0);
+
+    return result;
+}
+
+bool GPhotoExposureStatistics::isValid() const
+{
+    return 0 < sampledPixels;
+}
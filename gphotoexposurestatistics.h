@@ -0,0 +1,58 @@
+#ifndef GPHOTOEXPOSURESTATISTICS_H
+#define GPHOTOEXPOSURESTATISTICS_H
+
+#include <QMetaType>
+#include <QVector>
+#include <QVideoFrame>
+
+/** Exposure statistics of a live view frame.
+ *
+ * Preview worker computes them for every frame while video probes are
+ * attached and stores them in frame meta data under metaDataKey, so they
+ * travel along with the frame they describe. Properties are readable from
+ * QML as well.
+ *
+ * Big frames are sampled by lines, at most maxSampledLines of them.
+ */
+class GPhotoExposureStatistics
+{
+    Q_GADGET
+    Q_PROPERTY(QVector<int> redHistogram MEMBER redHistogram)
+    Q_PROPERTY(QVector<int> greenHistogram MEMBER greenHistogram)
+    Q_PROPERTY(QVector<int> blueHistogram MEMBER blueHistogram)
+    Q_PROPERTY(QVector<int> lumaHistogram MEMBER lumaHistogram)
+    Q_PROPERTY(int sampledPixels MEMBER sampledPixels)
+    Q_PROPERTY(qreal meanLuma MEMBER meanLuma)
+    Q_PROPERTY(int underexposedPixels MEMBER underexposedPixels)
+    Q_PROPERTY(int overexposedPixels MEMBER overexposedPixels)
+    Q_PROPERTY(QVector<qreal> zoneLuma MEMBER zoneLuma)
+public:
+    enum {
+        ZoneColumns = 4,
+        ZoneRows = 4
+    };
+
+    static const char *const metaDataKey;
+    static const int maxSampledLines;
+
+    /// Takes RGB32 and YUV 4:2:0 frames, statistics of others are empty
+    static GPhotoExposureStatistics analyze(const QVideoFrame &frame);
+
+    bool isValid() const;
+
+    QVector<int> redHistogram;
+    QVector<int> greenHistogram;
+    QVector<int> blueHistogram;
+    QVector<int> lumaHistogram;
+    int sampledPixels = 0;
+    qreal meanLuma = 0;
+    /// Pixels with luma in the lowest and highest clipping bins
+    int underexposedPixels = 0;
+    int overexposedPixels = 0;
+    /// Mean luma of ZoneColumns x ZoneRows frame zones, row by row
+    QVector<qreal> zoneLuma;
+};
+
+Q_DECLARE_METATYPE(GPhotoExposureStatistics)
+
+#endif // GPHOTOEXPOSURESTATISTICS_H
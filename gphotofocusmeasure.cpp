@@ -0,0 +1,116 @@
+#include "gphotofocusmeasure.h"
+#include "gphotokernels.h"
+
+const char *const GPhotoFocusMeasure::sharpnessMetaDataKey = "focusSharpness";
+const char *const GPhotoFocusMeasure::peakingMetaDataKey = "focusPeaking";
+
+namespace {
+    // Laplacian needs the neighbours of three lines
+    constexpr auto cachedLines = 3;
+
+    /// Luma lines of a mapped frame starting at the given column, RGB32 lines are converted on demand
+    class LumaLines
+    {
+    public:
+        LumaLines(const QVideoFrame &frame, int left, int width)
+            : m_frame(frame)
+            , m_left(left)
+            , m_width(width)
+        {
+            if (QVideoFrame::Format_RGB32 == m_frame.pixelFormat()) {
+                m_cache.resize(cachedLines * width);
+                for (auto &y : m_cachedY)
+                    y = -1;
+            }
+        }
+
+        const uchar* line(int y)
+        {
+            if (QVideoFrame::Format_YUV420P == m_frame.pixelFormat())
+                return m_frame.bits(0) + y * m_frame.bytesPerLine(0) + m_left;
+
+            const auto slot = y % cachedLines;
+            auto *luma = reinterpret_cast<uchar*>(m_cache.data()) + slot * m_width;
+            if (m_cachedY[slot] != y) {
+                const auto *pixels = m_frame.bits() + y * m_frame.bytesPerLine() + m_left * 4;
+                GPhotoKernels::lumaRgb32(pixels, m_width, luma);
+                m_cachedY[slot] = y;
+            }
+
+            return luma;
+        }
+
+    private:
+        const QVideoFrame &m_frame;
+        const int m_left;
+        const int m_width;
+        QByteArray m_cache;
+        int m_cachedY[cachedLines];
+    };
+
+    bool isMeasurable(const QVideoFrame &frame)
+    {
+        return (QVideoFrame::Format_RGB32 == frame.pixelFormat() || QVideoFrame::Format_YUV420P == frame.pixelFormat())
+                && frame.width() >= 3 && frame.height() >= 3;
+    }
+}
+
+qreal GPhotoFocusMeasure::sharpness(const QVideoFrame &frame, const QRectF &region)
+{
+    if (!isMeasurable(frame))
+        return -1;
+
+    // Border pixels have no neighbours
+    const QRect bounds(1, 1, frame.width() - 2, frame.height() - 2);
+    const auto &area = QRectF(region.x() * frame.width(), region.y() * frame.height(),
+                              region.width() * frame.width(), region.height() * frame.height())
+            .toAlignedRect().intersected(bounds);
+    if (area.isEmpty())
+        return -1;
+
+    // Mapping doesn't change the frame, a copy shares the same buffer
+    QVideoFrame source(frame);
+    if (!source.map(QAbstractVideoBuffer::ReadOnly))
+        return -1;
+
+    // Lines are read with a pixel of neighbours on both sides
+    LumaLines lines(source, area.left() - 1, area.width() + 2);
+
+    qint64 sum = 0;
+    quint64 squares = 0;
+    for (auto y = area.top(); y <= area.bottom(); ++y) {
+        GPhotoKernels::laplacian(lines.line(y - 1) + 1, lines.line(y) + 1, lines.line(y + 1) + 1, area.width(),
+                                 &sum, &squares);
+    }
+
+    source.unmap();
+
+    const auto count = qreal(area.width()) * area.height();
+    const auto mean = sum / count;
+    return squares / count - mean * mean;
+}
+
+QImage GPhotoFocusMeasure::peakingMask(const QVideoFrame &frame, int threshold)
+{
+    if (!isMeasurable(frame))
+        return QImage();
+
+    QVideoFrame source(frame);
+    if (!source.map(QAbstractVideoBuffer::ReadOnly))
+        return QImage();
+
+    const auto width = source.width();
+    const auto height = source.height();
+
+    QImage mask(width, height, QImage::Format_Grayscale8);
+    mask.fill(0);
+
+    LumaLines lines(source, 0, width);
+    for (auto y = 1; y < height - 1; ++y) {
+        GPhotoKernels::peakingMask(lines.line(y - 1) + 1, lines.line(y) + 1, lines.line(y + 1) + 1, width - 2,
+                                   threshold, mask.scanLine(y) + 1);
+    }
+
+    source.unmap();
+    return mask;
+}
@@ -0,0 +1,35 @@
+#ifndef GPHOTOFOCUSMEASURE_H
+#define GPHOTOFOCUSMEASURE_H
+
+#include <QImage>
+#include <QRectF>
+#include <QVideoFrame>
+
+/** Focus measures of live view frames.
+ *
+ * Sharpness is the variance of luma Laplacian in a region of the frame,
+ * it grows as the region gets into focus, so contrast autofocus looks for
+ * its peak. Values are comparable between frames of the same scene only.
+ *
+ * Peaking mask marks edges with Laplacian magnitude over a threshold, an
+ * application may draw it over the viewfinder to show what is in focus.
+ *
+ * Both take RGB32 and YUV 4:2:0 frames.
+ */
+class GPhotoFocusMeasure final
+{
+public:
+    static const char *const sharpnessMetaDataKey;
+    static const char *const peakingMetaDataKey;
+
+    /// Region is relative to frame size, negative result means that frame can't be measured
+    static qreal sharpness(const QVideoFrame &frame, const QRectF &region);
+
+    /// Grayscale mask of frame size, null for frames which can't be measured
+    static QImage peakingMask(const QVideoFrame &frame, int threshold);
+
+private:
+    GPhotoFocusMeasure() = delete;
+};
+
+#endif // GPHOTOFOCUSMEASURE_H
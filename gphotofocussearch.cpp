@@ -0,0 +1,123 @@
+#include "gphotofocussearch.h"
+
+namespace {
+    constexpr auto maxSamples = 80;
+    // Sharpness of live view frames jitters, smaller drops are not taken as a passed peak
+    constexpr auto noiseMargin = 0.03;
+    // Peak has to stand out from the blurriest position seen
+    constexpr auto minPeakRatio = 1.15;
+    // Lens far from the peak sees no change at all, the peak may be the other way
+    constexpr auto maxFlatSteps = 8;
+}
+
+void GPhotoFocusSearch::start()
+{
+    m_phase = Phase::Start;
+    m_direction = 1;
+    m_samples = 0;
+    m_improved = false;
+    m_reversed = false;
+    m_flatSteps = 0;
+    m_best = 0;
+    m_fineBest = 0;
+    m_peak = 0;
+    m_minimum = 0;
+}
+
+void GPhotoFocusSearch::stop()
+{
+    m_phase = Phase::Idle;
+}
+
+bool GPhotoFocusSearch::isActive() const
+{
+    return Phase::Idle != m_phase;
+}
+
+GPhotoFocusSearch::Action GPhotoFocusSearch::addSample(qreal sharpness)
+{
+    if (Phase::Idle == m_phase)
+        return Action::Failed;
+
+    m_minimum = (0 == m_samples) ? sharpness : qMin(m_minimum, sharpness);
+    m_peak = qMax(m_peak, sharpness);
+
+    if (++m_samples > maxSamples) {
+        m_phase = Phase::Idle;
+        return Action::Failed;
+    }
+
+    switch (m_phase) {
+    case Phase::Start:
+        m_best = sharpness;
+        m_phase = Phase::Coarse;
+        return Action::StepCoarse;
+
+    case Phase::Coarse:
+        if (sharpness > m_best * (1 + noiseMargin)) {
+            m_best = sharpness;
+            m_improved = true;
+            m_flatSteps = 0;
+            return Action::StepCoarse;
+        }
+
+        if (sharpness > m_best * (1 - noiseMargin)) {
+            m_best = qMax(m_best, sharpness);
+            if (!m_improved && !m_reversed && ++m_flatSteps >= maxFlatSteps) {
+                m_reversed = true;
+                m_direction = -m_direction;
+            }
+            return Action::StepCoarse;
+        }
+
+        // Starting position may be just behind the peak
+        if (!m_improved && !m_reversed) {
+            m_reversed = true;
+            m_direction = -m_direction;
+            return Action::StepCoarse;
+        }
+
+        // Peak is passed, it lies within the last two coarse steps
+        m_direction = -m_direction;
+        m_fineBest = sharpness;
+        m_phase = Phase::Fine;
+        return Action::StepFine;
+
+    case Phase::Fine:
+        if (sharpness > m_fineBest) {
+            m_fineBest = sharpness;
+            return Action::StepFine;
+        }
+
+        if (sharpness > m_fineBest * (1 - noiseMargin))
+            return Action::StepFine;
+
+        // One fine step back is the sharpest position
+        m_direction = -m_direction;
+        m_phase = Phase::Final;
+        return Action::StepFine;
+
+    case Phase::Final:
+        return finish();
+
+    case Phase::Idle:
+        break;
+    }
+
+    return Action::Failed;
+}
+
+int GPhotoFocusSearch::direction() const
+{
+    return m_direction;
+}
+
+GPhotoFocusSearch::Action GPhotoFocusSearch::finish()
+{
+    m_phase = Phase::Idle;
+
+    if (m_peak < m_minimum * minPeakRatio || qFuzzyIsNull(m_peak))
+        return Action::Failed;
+
+    return Action::Locked;
+}
@@ -0,0 +1,60 @@
+#ifndef GPHOTOFOCUSSEARCH_H
+#define GPHOTOFOCUSSEARCH_H
+
+#include <QtGlobal>
+
+/** Hill climbing search of the sharpness peak for contrast autofocus.
+ *
+ * Search only decides where to move, caller drives the lens and feeds back
+ * sharpness measured after every move. Lens is moved in coarse steps until
+ * sharpness drops past its best value, then it comes back in fine steps to
+ * the peak. If the first coarse step makes things worse, direction is
+ * reversed once. Search fails when it takes too many steps or when the
+ * scene has no contrast peak to find.
+ */
+class GPhotoFocusSearch final
+{
+public:
+    enum class Action {
+        StepCoarse,
+        StepFine,
+        Locked,
+        Failed
+    };
+
+    GPhotoFocusSearch() = default;
+
+    void start();
+    void stop();
+    bool isActive() const;
+
+    /// Takes sharpness at the current lens position, returns what to do next
+    Action addSample(qreal sharpness);
+
+    /// Direction of the next step, 1 is towards infinity and -1 is towards close focus
+    int direction() const;
+
+private:
+    enum class Phase {
+        Idle,
+        Start,
+        Coarse,
+        Fine,
+        Final
+    };
+
+    Action finish();
+
+    Phase m_phase = Phase::Idle;
+    int m_direction = 1;
+    int m_samples = 0;
+    int m_flatSteps = 0;
+    bool m_improved = false;
+    bool m_reversed = false;
+    qreal m_best = 0;
+    qreal m_fineBest = 0;
+    qreal m_peak = 0;
+    qreal m_minimum = 0;
+};
+
+#endif // GPHOTOFOCUSSEARCH_H
@@ -0,0 +1,188 @@
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <new>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <QDebug>
+
+#ifdef Q_OS_LINUX
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+#include "gphotoframeexporter.h"
+
+namespace {
+    constexpr auto slotAlignment = GPhotoFrameRingHeader::slotAlignment;
+    constexpr auto maxSlotCount = 64;
+
+    // Readers of other users get nothing unless the mode is changed on purpose
+    constexpr mode_t memoryMode = S_IRUSR | S_IWUSR;
+
+    size_t align(size_t size)
+    {
+        return (size + slotAlignment - 1) & ~size_t(slotAlignment - 1);
+    }
+}
+
+GPhotoFrameExporter::GPhotoFrameExporter() = default;
+
+GPhotoFrameExporter::~GPhotoFrameExporter()
+{
+    close();
+}
+
+bool GPhotoFrameExporter::open(const QString &name, int slotCount, int slotSize)
+{
+    close();
+
+    if (slotCount < 2 || slotCount > maxSlotCount || slotSize <= 0) {
+        qWarning() << "GPhoto: Invalid live view export ring:" << slotCount << "slots of" << slotSize << "bytes";
+        return false;
+    }
+
+    // POSIX shared memory names start with a single slash
+    m_name = name.toLocal8Bit();
+    if (!m_name.startsWith('/'))
+        m_name.prepend('/');
+
+    const auto slotStride = align(sizeof(GPhotoFrameRingSlot) + size_t(slotSize));
+    const auto headerSize = size_t(GPhotoFrameRingHeader::headerSize());
+    const auto memorySize = headerSize + slotStride * size_t(slotCount);
+
+    // Existing name may be a live ring of another exporter, only a ring created here is ever removed
+    auto fd = shm_open(m_name.constData(), O_RDWR | O_CREAT | O_EXCL, memoryMode);
+    if (fd < 0) {
+        if (EEXIST == errno)
+            qWarning() << "GPhoto: Live view export memory" << m_name << "exists already, remove it if it's stale";
+        else
+            qWarning() << "GPhoto: Unable to create live view export memory" << m_name << ":" << strerror(errno);
+        return false;
+    }
+
+    if (ftruncate(fd, off_t(memorySize)) < 0) {
+        qWarning() << "GPhoto: Unable to size live view export memory" << m_name << ":" << strerror(errno);
+        ::close(fd);
+        shm_unlink(m_name.constData());
+        return false;
+    }
+
+    auto memory = mmap(nullptr, memorySize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+
+    if (MAP_FAILED == memory) {
+        qWarning() << "GPhoto: Unable to map live view export memory" << m_name << ":" << strerror(errno);
+        shm_unlink(m_name.constData());
+        return false;
+    }
+
+    m_memory = static_cast<uchar*>(memory);
+    m_memorySize = memorySize;
+
+    m_header = new (m_memory) GPhotoFrameRingHeader;
+    m_header->magic = GPhotoFrameRingHeader::ringMagic;
+    m_header->version = GPhotoFrameRingHeader::ringVersion;
+    m_header->slotCount = quint32(slotCount);
+    m_header->slotSize = quint32(slotSize);
+    m_header->slotStride = quint32(slotStride);
+    m_header->wakeup.store(0);
+    m_header->lastSequence.store(0);
+
+    for (auto i = 0; i < slotCount; ++i)
+        new (m_memory + headerSize + slotStride * size_t(i)) GPhotoFrameRingSlot{};
+
+    m_sequence = 0;
+    m_oversizeReported = false;
+
+    return true;
+}
+
+void GPhotoFrameExporter::close()
+{
+    if (!m_memory)
+        return;
+
+    munmap(m_memory, m_memorySize);
+    shm_unlink(m_name.constData());
+
+    m_memory = nullptr;
+    m_memorySize = 0;
+    m_header = nullptr;
+}
+
+bool GPhotoFrameExporter::isOpen() const
+{
+    return nullptr != m_memory;
+}
+
+QString GPhotoFrameExporter::name() const
+{
+    return m_memory ? QString::fromLocal8Bit(m_name) : QString();
+}
+
+bool GPhotoFrameExporter::publish(const QVideoFrame &frame)
+{
+    if (!m_memory || !frame.isValid())
+        return false;
+
+    // Mapping doesn't change the frame, a copy shares the same buffer
+    QVideoFrame source(frame);
+    if (!source.map(QAbstractVideoBuffer::ReadOnly))
+        return false;
+
+    const auto dataSize = source.mappedBytes();
+    if (dataSize <= 0 || quint32(dataSize) > m_header->slotSize) {
+        if (!m_oversizeReported) {
+            qWarning() << "GPhoto: Live view frame of" << dataSize << "bytes doesn't fit export slot of"
+                       << m_header->slotSize << "bytes";
+            m_oversizeReported = true;
+        }
+        source.unmap();
+        return false;
+    }
+
+    const auto sequence = ++m_sequence;
+    auto target = slot(sequence);
+
+    // Readers which still look at the overwritten frame see the slot changing
+    target->sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    target->timestamp = frame.startTime();
+    target->pixelFormat = qint32(source.pixelFormat());
+    target->width = source.width();
+    target->height = source.height();
+    target->bytesPerLine = source.bytesPerLine();
+    target->dataSize = quint32(dataSize);
+    memcpy(reinterpret_cast<uchar*>(target) + sizeof(GPhotoFrameRingSlot), source.bits(), size_t(dataSize));
+
+    source.unmap();
+
+    target->sequence.store(sequence, std::memory_order_release);
+    m_header->lastSequence.store(sequence, std::memory_order_release);
+    wakeReaders();
+
+    return true;
+}
+
+GPhotoFrameRingSlot* GPhotoFrameExporter::slot(quint64 sequence) const
+{
+    const auto index = size_t(sequence % m_header->slotCount);
+    return reinterpret_cast<GPhotoFrameRingSlot*>(m_memory + GPhotoFrameRingHeader::headerSize()
+                                                  + size_t(m_header->slotStride) * index);
+}
+
+void GPhotoFrameExporter::wakeReaders()
+{
+    m_header->wakeup.fetch_add(1, std::memory_order_release);
+
+#ifdef Q_OS_LINUX
+    // Shared futex, readers live in other processes
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&m_header->wakeup), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+#endif
+}
@@ -0,0 +1,48 @@
+#ifndef GPHOTOFRAMEEXPORTER_H
+#define GPHOTOFRAMEEXPORTER_H
+
+#include <QString>
+#include <QVideoFrame>
+
+#include "gphotoframering.h"
+
+/** Publisher of live view frames to other local processes.
+ *
+ * Frames are copied to a POSIX shared memory ring, see GPhotoFrameRingHeader,
+ * which readers map read-only and use without touching libgphoto2. Frames
+ * bigger than a slot are skipped. A name which exists already isn't taken
+ * over, it may belong to an exporter of another process. The shared memory
+ * name is removed when exporter is closed, readers that already mapped it
+ * keep their mapping.
+ */
+class GPhotoFrameExporter final
+{
+public:
+    GPhotoFrameExporter();
+    ~GPhotoFrameExporter();
+
+    GPhotoFrameExporter(GPhotoFrameExporter&&) = delete;
+    GPhotoFrameExporter& operator=(GPhotoFrameExporter&&) = delete;
+
+    bool open(const QString &name, int slotCount, int slotSize);
+    void close();
+    bool isOpen() const;
+    QString name() const;
+
+    bool publish(const QVideoFrame &frame);
+
+private:
+    Q_DISABLE_COPY(GPhotoFrameExporter)
+
+    GPhotoFrameRingSlot* slot(quint64 sequence) const;
+    void wakeReaders();
+
+    QByteArray m_name;
+    uchar *m_memory = nullptr;
+    size_t m_memorySize = 0;
+    GPhotoFrameRingHeader *m_header = nullptr;
+    quint64 m_sequence = 0;
+    bool m_oversizeReported = false;
+};
+
+#endif // GPHOTOFRAMEEXPORTER_H
@@ -0,0 +1,66 @@
+#ifndef GPHOTOFRAMERING_H
+#define GPHOTOFRAMERING_H
+
+#include <atomic>
+#include <cstdint>
+
+/** Layout of the shared memory live view ring.
+ *
+ * Region starts with GPhotoFrameRingHeader followed by slotCount slots.
+ * Every slot is GPhotoFrameRingSlot header followed by slotSize bytes of
+ * frame data, slots start at multiples of GPhotoFrameRingHeader::slotStride
+ * after the ring header, which takes headerSize bytes.
+ *
+ * Frames are written to slots in turn. Slot sequence is zero while the
+ * slot is being written and frame sequence number once it's complete, so
+ * a reader takes the slot of lastSequence % slotCount, reads its sequence,
+ * uses frame data in place and reads the sequence again: frame is intact
+ * if both reads give the expected number. Readers may sleep on the wakeup
+ * word with FUTEX_WAIT, it changes and wakes everybody after every frame.
+ *
+ * This header needs neither Qt nor libgphoto2, readers include it alone.
+ */
+
+// Atomics are shared by processes, which works only when they don't take a lock of their own process
+#if __cplusplus >= 201703L
+static_assert(std::atomic<uint32_t>::is_always_lock_free && std::atomic<uint64_t>::is_always_lock_free,
+              "Live view ring needs lock-free 32-bit and 64-bit atomics");
+#else
+static_assert(2 == ATOMIC_INT_LOCK_FREE && 2 == ATOMIC_LLONG_LOCK_FREE,
+              "Live view ring needs lock-free 32-bit and 64-bit atomics");
+#endif
+
+struct GPhotoFrameRingHeader {
+    static constexpr uint32_t ringMagic = 0x47504652; // "GPFR"
+    static constexpr uint32_t ringVersion = 1;
+    /// Slots are cache line aligned, so writing one doesn't disturb readers of the others
+    static constexpr uint32_t slotAlignment = 64;
+
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slotCount;
+    uint32_t slotSize;
+    uint32_t slotStride;
+    std::atomic<uint32_t> wakeup;
+    std::atomic<uint64_t> lastSequence;
+
+    static constexpr uint32_t headerSize()
+    {
+        return (sizeof(GPhotoFrameRingHeader) + slotAlignment - 1) & ~(slotAlignment - 1);
+    }
+};
+
+struct GPhotoFrameRingSlot {
+    std::atomic<uint64_t> sequence;
+    /// Start time of the frame in microseconds of a monotonic clock
+    int64_t timestamp;
+    /// QVideoFrame::PixelFormat
+    int32_t pixelFormat;
+    int32_t width;
+    int32_t height;
+    /// Bytes per line of the first plane, other planes follow as QVideoFrame maps them
+    int32_t bytesPerLine;
+    uint32_t dataSize;
+};
+
+#endif // GPHOTOFRAMERING_H
@@ -0,0 +1,347 @@
+#include "gphotokernels.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace {
+    // BT.601 luma weights scaled to 256
+    constexpr auto redWeight = 77;
+    constexpr auto greenWeight = 150;
+    constexpr auto blueWeight = 29;
+
+    // JFIF YCbCr to RGB factors scaled to 65536
+    constexpr auto crToRed = 91881;
+    constexpr auto cbToGreen = 22554;
+    constexpr auto crToGreen = 46802;
+    constexpr auto cbToBlue = 116130;
+
+    constexpr auto vectorPixels = 16;
+    constexpr auto laplacianPixels = 8;
+    constexpr auto sadBlockSize = 8;
+
+    inline int lumaOf(int red, int green, int blue)
+    {
+        return (redWeight * red + greenWeight * green + blueWeight * blue) >> 8;
+    }
+
+    inline int clamp(int value)
+    {
+        return qBound(0, value, 255);
+    }
+
+#if defined(__SSE2__)
+    // RGB32 pixels are 0xffRRGGBB integers, channels are taken from 32-bit lanes
+    void lumaRgb32Block(const uchar *line, uchar *result)
+    {
+        const auto mask = _mm_set1_epi32(0xff);
+        const auto redWeights = _mm_set1_epi32(redWeight);
+        const auto greenWeights = _mm_set1_epi32(greenWeight);
+        const auto blueWeights = _mm_set1_epi32(blueWeight);
+
+        __m128i lumas[4];
+        for (auto i = 0; i < 4; ++i) {
+            const auto pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(line) + i);
+            const auto blue = _mm_and_si128(pixels, mask);
+            const auto green = _mm_and_si128(_mm_srli_epi32(pixels, 8), mask);
+            const auto red = _mm_and_si128(_mm_srli_epi32(pixels, 16), mask);
+
+            // Weighted sum fits 16 bits, so 16-bit multiplication of zero extended lanes is exact
+            auto sum = _mm_add_epi32(_mm_mullo_epi16(red, redWeights), _mm_mullo_epi16(green, greenWeights));
+            sum = _mm_add_epi32(sum, _mm_mullo_epi16(blue, blueWeights));
+            lumas[i] = _mm_srli_epi32(sum, 8);
+        }
+
+        const auto low = _mm_packs_epi32(lumas[0], lumas[1]);
+        const auto high = _mm_packs_epi32(lumas[2], lumas[3]);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(result), _mm_packus_epi16(low, high));
+    }
+
+    quint64 sumBytes(const uchar *line)
+    {
+        const auto sums = _mm_sad_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(line)), _mm_setzero_si128());
+        return quint64(_mm_cvtsi128_si32(sums)) + quint64(_mm_cvtsi128_si32(_mm_srli_si128(sums, 8)));
+    }
+
+    // 4-neighbour Laplacian of 8 pixels, it fits 16 bits
+    inline __m128i laplacianBlock(const uchar *above, const uchar *line, const uchar *below)
+    {
+        const auto zero = _mm_setzero_si128();
+        const auto load = [zero] (const uchar *pixels) {
+            return _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(pixels)), zero);
+        };
+
+        const auto neighbours = _mm_add_epi16(_mm_add_epi16(load(line - 1), load(line + 1)),
+                                              _mm_add_epi16(load(above), load(below)));
+        return _mm_sub_epi16(_mm_slli_epi16(load(line), 2), neighbours);
+    }
+
+    void laplacianSums(const uchar *above, const uchar *line, const uchar *below, qint64 *sum, quint64 *squares)
+    {
+        const auto laplacian = laplacianBlock(above, line, below);
+        const auto sums = _mm_madd_epi16(laplacian, _mm_set1_epi16(1));
+        const auto squareSums = _mm_madd_epi16(laplacian, laplacian);
+
+        qint32 lanes[4];
+        quint32 squareLanes[4];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), sums);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(squareLanes), squareSums);
+
+        *sum += qint64(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+        *squares += quint64(squareLanes[0]) + squareLanes[1] + squareLanes[2] + squareLanes[3];
+    }
+
+    void peakingBlock(const uchar *above, const uchar *line, const uchar *below, int threshold, uchar *mask)
+    {
+        const auto laplacian = laplacianBlock(above, line, below);
+        const auto magnitude = _mm_max_epi16(laplacian, _mm_sub_epi16(_mm_setzero_si128(), laplacian));
+        const auto edges = _mm_cmpgt_epi16(magnitude, _mm_set1_epi16(short(threshold)));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(mask), _mm_packs_epi16(edges, edges));
+    }
+
+    // Line of two neighbouring blocks is a single vector, its halves are summed separately
+    void sadBlockPair(const uchar *previous, const uchar *current, int stride, quint32 *sads)
+    {
+        auto sums = _mm_setzero_si128();
+        for (auto y = 0; y < sadBlockSize; ++y) {
+            const auto a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(previous + y * stride));
+            const auto b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(current + y * stride));
+            sums = _mm_add_epi32(sums, _mm_sad_epu8(a, b));
+        }
+
+        sads[0] = quint32(_mm_cvtsi128_si32(sums));
+        sads[1] = quint32(_mm_cvtsi128_si32(_mm_srli_si128(sums, 8)));
+    }
+#elif defined(__ARM_NEON)
+    // Little endian RGB32 pixels are B, G, R, X bytes
+    void lumaRgb32Block(const uchar *line, uchar *result)
+    {
+        const auto pixels = vld4q_u8(line);
+
+        auto low = vmull_u8(vget_low_u8(pixels.val[2]), vdup_n_u8(redWeight));
+        low = vmlal_u8(low, vget_low_u8(pixels.val[1]), vdup_n_u8(greenWeight));
+        low = vmlal_u8(low, vget_low_u8(pixels.val[0]), vdup_n_u8(blueWeight));
+
+        auto high = vmull_u8(vget_high_u8(pixels.val[2]), vdup_n_u8(redWeight));
+        high = vmlal_u8(high, vget_high_u8(pixels.val[1]), vdup_n_u8(greenWeight));
+        high = vmlal_u8(high, vget_high_u8(pixels.val[0]), vdup_n_u8(blueWeight));
+
+        vst1q_u8(result, vcombine_u8(vshrn_n_u16(low, 8), vshrn_n_u16(high, 8)));
+    }
+
+    quint64 sumBytes(const uchar *line)
+    {
+        const auto sums = vpaddlq_u32(vpaddlq_u16(vpaddlq_u8(vld1q_u8(line))));
+        return vgetq_lane_u64(sums, 0) + vgetq_lane_u64(sums, 1);
+    }
+
+    // 4-neighbour Laplacian of 8 pixels, it fits 16 bits
+    inline int16x8_t laplacianBlock(const uchar *above, const uchar *line, const uchar *below)
+    {
+        const auto neighbours = vaddq_u16(vaddl_u8(vld1_u8(line - 1), vld1_u8(line + 1)),
+                                          vaddl_u8(vld1_u8(above), vld1_u8(below)));
+        return vsubq_s16(vreinterpretq_s16_u16(vshll_n_u8(vld1_u8(line), 2)), vreinterpretq_s16_u16(neighbours));
+    }
+
+    void laplacianSums(const uchar *above, const uchar *line, const uchar *below, qint64 *sum, quint64 *squares)
+    {
+        const auto laplacian = laplacianBlock(above, line, below);
+        const auto low = vget_low_s16(laplacian);
+        const auto high = vget_high_s16(laplacian);
+
+        const auto sums = vpaddlq_s32(vpaddlq_s16(laplacian));
+        const auto squareSums = vpaddlq_u32(vreinterpretq_u32_s32(vmull_s16(low, low)));
+        const auto highSquareSums = vpaddlq_u32(vreinterpretq_u32_s32(vmull_s16(high, high)));
+
+        *sum += vgetq_lane_s64(sums, 0) + vgetq_lane_s64(sums, 1);
+        *squares += vgetq_lane_u64(squareSums, 0) + vgetq_lane_u64(squareSums, 1)
+                + vgetq_lane_u64(highSquareSums, 0) + vgetq_lane_u64(highSquareSums, 1);
+    }
+
+    void peakingBlock(const uchar *above, const uchar *line, const uchar *below, int threshold, uchar *mask)
+    {
+        const auto magnitude = vabsq_s16(laplacianBlock(above, line, below));
+        vst1_u8(mask, vmovn_u16(vcgtq_s16(magnitude, vdupq_n_s16(short(threshold)))));
+    }
+
+    // Line of two neighbouring blocks is a single vector, its halves are summed separately
+    void sadBlockPair(const uchar *previous, const uchar *current, int stride, quint32 *sads)
+    {
+        // Pairwise sums of 8 lines fit 16-bit lanes
+        auto sums = vdupq_n_u16(0);
+        for (auto y = 0; y < sadBlockSize; ++y)
+            sums = vpadalq_u8(sums, vabdq_u8(vld1q_u8(previous + y * stride), vld1q_u8(current + y * stride)));
+
+        const auto totals = vpaddlq_u32(vpaddlq_u16(sums));
+        sads[0] = quint32(vgetq_lane_u64(totals, 0));
+        sads[1] = quint32(vgetq_lane_u64(totals, 1));
+    }
+#else
+    void lumaRgb32Block(const uchar *line, uchar *result)
+    {
+        const auto *pixels = reinterpret_cast<const quint32*>(line);
+        for (auto i = 0; i < vectorPixels; ++i)
+            result[i] = uchar(lumaOf((pixels[i] >> 16) & 0xff, (pixels[i] >> 8) & 0xff, pixels[i] & 0xff));
+    }
+
+    quint64 sumBytes(const uchar *line)
+    {
+        quint64 sum = 0;
+        for (auto i = 0; i < vectorPixels; ++i)
+            sum += line[i];
+        return sum;
+    }
+#endif
+
+    inline int laplacian(const uchar *above, const uchar *line, const uchar *below, int i)
+    {
+        return 4 * line[i] - line[i - 1] - line[i + 1] - above[i] - below[i];
+    }
+
+    quint32 sadBlock(const uchar *previous, const uchar *current, int stride)
+    {
+        quint32 sum = 0;
+        for (auto y = 0; y < sadBlockSize; ++y) {
+            for (auto x = 0; x < sadBlockSize; ++x)
+                sum += quint32(qAbs(previous[y * stride + x] - current[y * stride + x]));
+        }
+        return sum;
+    }
+
+#if !defined(__SSE2__) && !defined(__ARM_NEON)
+    void laplacianSums(const uchar *above, const uchar *line, const uchar *below, qint64 *sum, quint64 *squares)
+    {
+        for (auto i = 0; i < laplacianPixels; ++i) {
+            const auto value = laplacian(above, line, below, i);
+            *sum += value;
+            *squares += quint64(value * value);
+        }
+    }
+
+    void peakingBlock(const uchar *above, const uchar *line, const uchar *below, int threshold, uchar *mask)
+    {
+        for (auto i = 0; i < laplacianPixels; ++i)
+            mask[i] = (qAbs(laplacian(above, line, below, i)) > threshold) ? 255 : 0;
+    }
+
+    void sadBlockPair(const uchar *previous, const uchar *current, int stride, quint32 *sads)
+    {
+        sads[0] = sadBlock(previous, current, stride);
+        sads[1] = sadBlock(previous + sadBlockSize, current + sadBlockSize, stride);
+    }
+#endif
+}
+
+namespace GPhotoKernels {
+    quint64 histogramRgb32(const uchar *line, int count,
+                           quint32 *red, quint32 *green, quint32 *blue, quint32 *luma)
+    {
+        const auto *pixels = reinterpret_cast<const quint32*>(line);
+        quint64 sum = 0;
+        auto i = 0;
+
+        uchar lumas[vectorPixels];
+        for (; i + vectorPixels <= count; i += vectorPixels) {
+            lumaRgb32Block(line + i * 4, lumas);
+            for (auto j = 0; j < vectorPixels; ++j) {
+                const auto pixel = pixels[i + j];
+                ++red[(pixel >> 16) & 0xff];
+                ++green[(pixel >> 8) & 0xff];
+                ++blue[pixel & 0xff];
+                ++luma[lumas[j]];
+                sum += lumas[j];
+            }
+        }
+
+        for (; i < count; ++i) {
+            const auto pixel = pixels[i];
+            const auto value = lumaOf((pixel >> 16) & 0xff, (pixel >> 8) & 0xff, pixel & 0xff);
+            ++red[(pixel >> 16) & 0xff];
+            ++green[(pixel >> 8) & 0xff];
+            ++blue[pixel & 0xff];
+            ++luma[value];
+            sum += value;
+        }
+
+        return sum;
+    }
+
+    quint64 histogramLuma(const uchar *line, int count, quint32 *luma)
+    {
+        quint64 sum = 0;
+        auto i = 0;
+
+        for (; i + vectorPixels <= count; i += vectorPixels)
+            sum += sumBytes(line + i);
+
+        for (auto j = i; j < count; ++j)
+            sum += line[j];
+
+        for (i = 0; i < count; ++i)
+            ++luma[line[i]];
+
+        return sum;
+    }
+
+    void histogramYuv420(const uchar *y, const uchar *u, const uchar *v, int count,
+                         quint32 *red, quint32 *green, quint32 *blue)
+    {
+        for (auto i = 0; i < count; ++i) {
+            const auto cb = u[i / 2] - 128;
+            const auto cr = v[i / 2] - 128;
+            const auto value = y[i];
+
+            ++red[clamp(value + ((crToRed * cr + 32768) >> 16))];
+            ++green[clamp(value - ((cbToGreen * cb + crToGreen * cr + 32768) >> 16))];
+            ++blue[clamp(value + ((cbToBlue * cb + 32768) >> 16))];
+        }
+    }
+
+    void lumaRgb32(const uchar *line, int count, uchar *luma)
+    {
+        const auto *pixels = reinterpret_cast<const quint32*>(line);
+        auto i = 0;
+
+        for (; i + vectorPixels <= count; i += vectorPixels)
+            lumaRgb32Block(line + i * 4, luma + i);
+
+        for (; i < count; ++i)
+            luma[i] = uchar(lumaOf((pixels[i] >> 16) & 0xff, (pixels[i] >> 8) & 0xff, pixels[i] & 0xff));
+    }
+
+    void laplacian(const uchar *above, const uchar *line, const uchar *below, int count,
+                   qint64 *sum, quint64 *squares)
+    {
+        auto i = 0;
+        for (; i + laplacianPixels <= count; i += laplacianPixels)
+            laplacianSums(above + i, line + i, below + i, sum, squares);
+
+        for (; i < count; ++i) {
+            const auto value = ::laplacian(above, line, below, i);
+            *sum += value;
+            *squares += quint64(value * value);
+        }
+    }
+
+    void peakingMask(const uchar *above, const uchar *line, const uchar *below, int count, int threshold, uchar *mask)
+    {
+        auto i = 0;
+        for (; i + laplacianPixels <= count; i += laplacianPixels)
+            peakingBlock(above + i, line + i, below + i, threshold, mask + i);
+
+        for (; i < count; ++i)
+            mask[i] = (qAbs(::laplacian(above, line, below, i)) > threshold) ? 255 : 0;
+    }
+
+    void blockSad(const uchar *previous, const uchar *current, int stride, int blocks, quint32 *sads)
+    {
+        auto i = 0;
+        for (; i + 2 <= blocks; i += 2)
+            sadBlockPair(previous + i * sadBlockSize, current + i * sadBlockSize, stride, sads + i);
+
+        if (i < blocks)
+            sads[i] = sadBlock(previous + i * sadBlockSize, current + i * sadBlockSize, stride);
+    }
+}
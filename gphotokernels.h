@@ -0,0 +1,42 @@
+#ifndef GPHOTOKERNELS_H
+#define GPHOTOKERNELS_H
+
+#include <QtGlobal>
+
+/** Pixel loops of live view statistics.
+ *
+ * Kernels take single lines, so callers may sample only some lines of a
+ * big frame or take a region of it. Histograms have 256 bins and are added to, not cleared. Luma
+ * is BT.601 with full range, as JPEG uses it.
+ *
+ * SSE2 and NEON versions are chosen at build time, there is no runtime
+ * dispatch: SSE2 is part of x86-64 and NEON of AArch64. Histogram updates
+ * themselves are scattered stores, vector code computes luma and sums.
+ */
+namespace GPhotoKernels {
+    /// Adds RGB32 pixels to channel and luma histograms, returns luma sum
+    quint64 histogramRgb32(const uchar *line, int count,
+                           quint32 *red, quint32 *green, quint32 *blue, quint32 *luma);
+
+    /// Adds luma plane pixels to histogram, returns luma sum
+    quint64 histogramLuma(const uchar *line, int count, quint32 *luma);
+
+    /// Adds YUV 4:2:0 pixels to channel histograms, chroma lines are half as wide as luma one
+    void histogramYuv420(const uchar *y, const uchar *u, const uchar *v, int count,
+                         quint32 *red, quint32 *green, quint32 *blue);
+
+    /// Converts RGB32 pixels to luma
+    void lumaRgb32(const uchar *line, int count, uchar *luma);
+
+    /// Adds 4-neighbour Laplacian of luma pixels and its squares to sums, pixels around them are read too
+    void laplacian(const uchar *above, const uchar *line, const uchar *below, int count,
+                   qint64 *sum, quint64 *squares);
+
+    /// Marks luma pixels with Laplacian magnitude over threshold with 255, others with 0
+    void peakingMask(const uchar *above, const uchar *line, const uchar *below, int count, int threshold, uchar *mask);
+
+    /// Sums of absolute differences of 8x8 blocks in a row of blocks, lines of both planes are stride apart
+    void blockSad(const uchar *previous, const uchar *current, int stride, int blocks, quint32 *sads);
+}
+
+#endif // GPHOTOKERNELS_H
@@ -9,6 +9,7 @@
 #include "gphotovideoinputdevicecontrol.h"
 #include "gphotovideoprobecontrol.h"
 #include "gphotovideorenderercontrol.h"
+#include "gphotoviewfindersettingscontrol.h"
 
 GPhotoMediaService::GPhotoMediaService(std::weak_ptr<GPhotoController> controller, QObject *parent)
     : QMediaService(parent)
@@ -49,6 +50,9 @@ QMediaControl *GPhotoMediaService::requestControl(const char *name)
     if (qstrcmp(name, QVideoRendererControl_iid) == 0)
         return new GPhotoVideoRendererControl(m_session.get(), this);
 
+    if (qstrcmp(name, QCameraViewfinderSettingsControl2_iid) == 0)
+        return new GPhotoViewfinderSettingsControl(m_session.get(), this);
+
     return nullptr;
 }
 
@@ -0,0 +1,199 @@
+#include <cmath>
+
+#include "gphotokernels.h"
+#include "gphotomotiondetector.h"
+
+const char *const GPhotoMotionDetector::metaDataKey = "motion";
+
+namespace {
+    constexpr auto blockSize = 8;
+
+    // Luma plane is at most 20 blocks wide, live view noise and compression artifacts average out at this scale
+    constexpr auto maxPlaneWidth = 160;
+
+    // A single changed block is more likely noise than motion
+    constexpr auto minChangedBlocks = 2;
+    constexpr auto minChangedRatio = 0.02;
+}
+
+bool GPhotoMotionDetector::isEnabled() const
+{
+    return 0 < m_threshold;
+}
+
+void GPhotoMotionDetector::setRegions(const QVector<QRectF> &regions)
+{
+    if (m_regions != regions) {
+        m_regions = regions;
+        m_maskValid = false;
+    }
+}
+
+void GPhotoMotionDetector::setThreshold(int threshold)
+{
+    m_threshold = qBound(0, threshold, 255);
+
+    // Reference frame goes stale while nothing is detected
+    if (!isEnabled())
+        reset();
+}
+
+void GPhotoMotionDetector::setCooldown(int msec)
+{
+    m_cooldown = qint64(qMax(0, msec)) * 1000;
+}
+
+void GPhotoMotionDetector::reset()
+{
+    m_previous.clear();
+}
+
+void GPhotoMotionDetector::hold(qint64 timestamp)
+{
+    m_quietUntil = qMax(m_quietUntil, timestamp + m_cooldown);
+}
+
+bool GPhotoMotionDetector::process(const QVideoFrame &frame, qint64 timestamp, qreal *changedRatio)
+{
+    *changedRatio = -1;
+
+    if (!isEnabled() || !sample(frame))
+        return false;
+
+    // New plane becomes the reference of the next frame, the old one is reused for sampling
+    m_current.swap(m_previous);
+    if (m_current.size() != m_previous.size())
+        return false;
+
+    if (!m_maskValid)
+        updateMask();
+
+    const auto columns = m_planeWidth / blockSize;
+    const auto rows = m_planeHeight / blockSize;
+    const auto limit = quint32(m_threshold * blockSize * blockSize);
+    const auto *reference = reinterpret_cast<const uchar*>(m_current.constData());
+    const auto *plane = reinterpret_cast<const uchar*>(m_previous.constData());
+
+    auto changed = 0;
+    for (auto row = 0; row < rows; ++row) {
+        const auto offset = row * blockSize * m_planeWidth;
+        GPhotoKernels::blockSad(reference + offset, plane + offset, m_planeWidth, columns, m_sads.data());
+
+        for (auto column = 0; column < columns; ++column) {
+            if (m_mask.at(row * columns + column) && m_sads.at(column) > limit)
+                ++changed;
+        }
+    }
+
+    if (0 == m_watchedBlocks) {
+        *changedRatio = 0;
+        return false;
+    }
+
+    *changedRatio = qreal(changed) / m_watchedBlocks;
+
+    const auto needed = qMax(minChangedBlocks, int(std::ceil(m_watchedBlocks * minChangedRatio)));
+    if (changed < qMin(needed, m_watchedBlocks) || timestamp < m_quietUntil)
+        return false;
+
+    m_quietUntil = timestamp + m_cooldown;
+    return true;
+}
+
+bool GPhotoMotionDetector::sample(const QVideoFrame &frame)
+{
+    const auto format = frame.pixelFormat();
+    if (QVideoFrame::Format_RGB32 != format && QVideoFrame::Format_YUV420P != format)
+        return false;
+
+    if (m_frameSize != frame.size())
+        updateGeometry(frame.size());
+
+    if (0 == m_planeWidth || 0 == m_planeHeight)
+        return false;
+
+    // Mapping doesn't change the frame, a copy shares the same buffer
+    QVideoFrame source(frame);
+    if (!source.map(QAbstractVideoBuffer::ReadOnly))
+        return false;
+
+    m_current.resize(m_planeWidth * m_planeHeight);
+    auto *plane = reinterpret_cast<uchar*>(m_current.data());
+    auto *luma = reinterpret_cast<uchar*>(m_line.data());
+    const auto frameWidth = m_frameSize.width();
+    const auto frameHeight = m_frameSize.height();
+
+    // Nearest lines and columns are taken, block sums average the rest of the noise
+    for (auto y = 0; y < m_planeHeight; ++y) {
+        const auto sourceY = (2 * y + 1) * frameHeight / (2 * m_planeHeight);
+        const uchar *line = nullptr;
+
+        if (QVideoFrame::Format_YUV420P == format) {
+            line = source.bits(0) + sourceY * source.bytesPerLine(0);
+        } else {
+            GPhotoKernels::lumaRgb32(source.bits() + sourceY * source.bytesPerLine(), frameWidth, luma);
+            line = luma;
+        }
+
+        auto *planeLine = plane + y * m_planeWidth;
+        for (auto x = 0; x < m_planeWidth; ++x)
+            planeLine[x] = line[m_columns.at(x)];
+    }
+
+    source.unmap();
+    return true;
+}
+
+void GPhotoMotionDetector::updateGeometry(const QSize &frameSize)
+{
+    m_frameSize = frameSize;
+    m_planeWidth = 0;
+    m_planeHeight = 0;
+    m_previous.clear();
+    m_maskValid = false;
+
+    if (frameSize.isEmpty())
+        return;
+
+    // Plane keeps frame aspect ratio and holds whole blocks only
+    const auto width = qMin(frameSize.width(), maxPlaneWidth);
+    m_planeWidth = width / blockSize * blockSize;
+    m_planeHeight = width * frameSize.height() / frameSize.width() / blockSize * blockSize;
+    if (0 == m_planeWidth || 0 == m_planeHeight) {
+        m_planeWidth = 0;
+        m_planeHeight = 0;
+        return;
+    }
+
+    m_columns.resize(m_planeWidth);
+    for (auto x = 0; x < m_planeWidth; ++x)
+        m_columns[x] = (2 * x + 1) * frameSize.width() / (2 * m_planeWidth);
+
+    m_line.resize(frameSize.width());
+    m_sads.resize(m_planeWidth / blockSize);
+}
+
+void GPhotoMotionDetector::updateMask()
+{
+    const auto columns = m_planeWidth / blockSize;
+    const auto rows = m_planeHeight / blockSize;
+
+    m_mask.fill(m_regions.isEmpty(), columns * rows);
+    m_watchedBlocks = m_regions.isEmpty() ? columns * rows : 0;
+
+    // Block is watched when its centre lies in some region
+    for (auto row = 0; row < rows && !m_regions.isEmpty(); ++row) {
+        for (auto column = 0; column < columns; ++column) {
+            const QPointF centre((column + 0.5) / columns, (row + 0.5) / rows);
+            for (const auto &region : m_regions) {
+                if (region.contains(centre)) {
+                    m_mask[row * columns + column] = true;
+                    ++m_watchedBlocks;
+                    break;
+                }
+            }
+        }
+    }
+
+    m_maskValid = true;
+}
@@ -0,0 +1,74 @@
+#ifndef GPHOTOMOTIONDETECTOR_H
+#define GPHOTOMOTIONDETECTOR_H
+
+#include <QByteArray>
+#include <QRectF>
+#include <QSize>
+#include <QVector>
+#include <QVideoFrame>
+
+/** Motion detector of live view frames.
+ *
+ * Every frame is reduced to a small luma plane, which is compared with the
+ * plane of the previous frame in 8x8 blocks. A block has changed when the
+ * mean absolute difference of its pixels exceeds the threshold, motion is
+ * found when enough of the watched blocks have changed. Regions limit the
+ * watched blocks to parts of the frame, so a busy background doesn't set
+ * it off. After a trigger the detector keeps quiet for the cooldown time.
+ *
+ * Takes RGB32 and YUV 4:2:0 frames, timestamps are GPhotoPreviewWorker::clock()
+ * microseconds.
+ */
+class GPhotoMotionDetector final
+{
+public:
+    /// Part of watched blocks changed since the previous frame
+    static const char *const metaDataKey;
+
+    GPhotoMotionDetector() = default;
+
+    GPhotoMotionDetector(GPhotoMotionDetector&&) = delete;
+    GPhotoMotionDetector& operator=(GPhotoMotionDetector&&) = delete;
+
+    bool isEnabled() const;
+
+    /// Regions are relative to frame size, empty list watches the whole frame
+    void setRegions(const QVector<QRectF> &regions);
+    /// Mean absolute luma difference of a changed block, zero turns detection off
+    void setThreshold(int threshold);
+    void setCooldown(int msec);
+
+    /// Drops the reference frame, the next frame becomes a new one
+    void reset();
+    /// Holds triggers for cooldown time from timestamp
+    void hold(qint64 timestamp);
+
+    /// Returns true when frame triggers, changed part is negative for frames which can't be compared
+    bool process(const QVideoFrame &frame, qint64 timestamp, qreal *changedRatio);
+
+private:
+    Q_DISABLE_COPY(GPhotoMotionDetector)
+
+    bool sample(const QVideoFrame &frame);
+    void updateGeometry(const QSize &frameSize);
+    void updateMask();
+
+    QVector<QRectF> m_regions;
+    int m_threshold = 0;
+    qint64 m_cooldown = 0;
+    qint64 m_quietUntil = 0;
+
+    QSize m_frameSize;
+    int m_planeWidth = 0;
+    int m_planeHeight = 0;
+    QVector<int> m_columns;
+    QByteArray m_line;
+    QByteArray m_current;
+    QByteArray m_previous;
+    QVector<quint32> m_sads;
+    QVector<bool> m_mask;
+    int m_watchedBlocks = 0;
+    bool m_maskValid = false;
+};
+
+#endif // GPHOTOMOTIONDETECTOR_H
@@ -0,0 +1,441 @@
+#include <QDebug>
+#include <QImage>
+#include <QtMath>
+
+#include "gphotopreviewdecoder.h"
+#include "gphotovideobuffer.h"
+#include "gphotovideobufferpool.h"
+
+namespace {
+    constexpr auto maxRowsPerRead = 16U;
+
+    const QRectF fullRegion(0, 0, 1, 1);
+
+#ifdef JCS_EXTENSIONS
+    // QImage::Format_RGB32 is 0xffRRGGBB in native byte order, libjpeg-turbo fills X bytes with 0xff
+    constexpr auto outputColorSpace = (Q_BYTE_ORDER == Q_LITTLE_ENDIAN) ? JCS_EXT_BGRX : JCS_EXT_XRGB;
+    constexpr auto outputFormat = QImage::Format_RGB32;
+    constexpr auto outputBytesPerPixel = 4;
+#else
+    constexpr auto outputColorSpace = JCS_RGB;
+    constexpr auto outputFormat = QImage::Format_RGB888;
+    constexpr auto outputBytesPerPixel = 3;
+#endif
+
+    // Scaled block size moved to separate vertical and horizontal sizes in libjpeg 7
+#if JPEG_LIB_VERSION >= 70
+    int dctScaledWidth(const jpeg_component_info &component)
+    {
+        return component.DCT_h_scaled_size;
+    }
+
+    int dctScaledHeight(const jpeg_component_info &component)
+    {
+        return component.DCT_v_scaled_size;
+    }
+
+    int minDctScaledHeight(const jpeg_decompress_struct &info)
+    {
+        return info.min_DCT_v_scaled_size;
+    }
+#else
+    int dctScaledWidth(const jpeg_component_info &component)
+    {
+        return component.DCT_scaled_size;
+    }
+
+    int dctScaledHeight(const jpeg_component_info &component)
+    {
+        return component.DCT_scaled_size;
+    }
+
+    int minDctScaledHeight(const jpeg_decompress_struct &info)
+    {
+        return info.min_DCT_scaled_size;
+    }
+#endif
+
+    // Luma samples per decoded sample of a component, zero when they don't divide.
+    // Scaled decoding upsamples chroma in IDCT, so this isn't given by sampling factors alone
+    int samplingRatio(int lumaSamples, int componentSamples)
+    {
+        return (0 < componentSamples && 0 == lumaSamples % componentSamples) ? lumaSamples / componentSamples : 0;
+    }
+
+    int horizontalRatio(const jpeg_decompress_struct &info, int c)
+    {
+        const auto &luma = info.comp_info[0];
+        const auto &component = info.comp_info[c];
+        return samplingRatio(luma.h_samp_factor * dctScaledWidth(luma), component.h_samp_factor * dctScaledWidth(component));
+    }
+
+    int verticalRatio(const jpeg_decompress_struct &info, int c)
+    {
+        const auto &luma = info.comp_info[0];
+        const auto &component = info.comp_info[c];
+        return samplingRatio(luma.v_samp_factor * dctScaledHeight(luma), component.v_samp_factor * dctScaledHeight(component));
+    }
+
+    // Averages xStep by yStep samples of decoded chroma into every sample of the 4:2:0 plane,
+    // with a step of 1 the corner samples coincide and the average is taken in the other direction
+    void halveChroma(const uchar *source, int sourceStride, int xStep, int yStep,
+                     uchar *plane, int stride, int width, int height)
+    {
+        for (auto y = 0; y < height; ++y) {
+            const auto *top = source + y * yStep * sourceStride;
+            const auto *bottom = top + (yStep - 1) * sourceStride;
+            auto *line = plane + y * stride;
+
+            for (auto x = 0; x < width; ++x) {
+                const auto left = x * xStep;
+                const auto right = left + xStep - 1;
+                line[x] = uchar((top[left] + top[right] + bottom[left] + bottom[right] + 2) / 4);
+            }
+        }
+    }
+}
+
+GPhotoPreviewDecoder::GPhotoPreviewDecoder()
+{
+    m_info.err = jpeg_std_error(&m_error.base);
+    m_error.base.error_exit = errorExit;
+    m_error.base.output_message = outputMessage;
+
+    jpeg_create_decompress(&m_info);
+}
+
+GPhotoPreviewDecoder::~GPhotoPreviewDecoder()
+{
+    jpeg_destroy_decompress(&m_info);
+}
+
+QSize GPhotoPreviewDecoder::targetSize() const
+{
+    return m_targetSize;
+}
+
+void GPhotoPreviewDecoder::setTargetSize(const QSize &size)
+{
+    m_targetSize = size;
+}
+
+QRectF GPhotoPreviewDecoder::crop() const
+{
+    return m_crop;
+}
+
+void GPhotoPreviewDecoder::setCrop(const QRectF &region)
+{
+    // Whole image and a region outside of it both mean no crop
+    const auto &crop = region.intersected(fullRegion);
+    m_crop = (crop.isEmpty() || fullRegion == crop) ? QRectF() : crop;
+}
+
+QRectF GPhotoPreviewDecoder::decodedRegion() const
+{
+    return m_decodedRegion;
+}
+
+QVideoFrame GPhotoPreviewDecoder::decode(const char *data, unsigned long size, QVideoFrame::PixelFormat format,
+                                         GPhotoVideoBufferPool &pool)
+{
+    if (setjmp(m_error.jump)) {
+        jpeg_abort_decompress(&m_info);
+        return QVideoFrame();
+    }
+
+    // Older libjpeg versions take non-const source buffer
+    jpeg_mem_src(&m_info, reinterpret_cast<unsigned char*>(const_cast<char*>(data)), size);
+
+    if (JPEG_HEADER_OK != jpeg_read_header(&m_info, TRUE)) {
+        jpeg_abort_decompress(&m_info);
+        return QVideoFrame();
+    }
+
+    // Cropped region is what has to cover the target
+    const auto &region = m_crop.isNull() ? fullRegion : m_crop;
+    m_info.scale_num = 1;
+    m_info.scale_denom = scaleDenominator(qCeil(m_info.image_width * region.width()),
+                                          qCeil(m_info.image_height * region.height()));
+    m_info.dct_method = JDCT_IFAST;
+
+    if (QVideoFrame::Format_YUV420P == format && m_crop.isNull()) {
+        // Scaled sizes of components are known only when scaling is applied
+        jpeg_calc_output_dimensions(&m_info);
+        if (canDecodeYuv420())
+            return decodeYuv420(pool);
+    }
+
+    return decodeRgb32(pool);
+}
+
+QSize GPhotoPreviewDecoder::frameSize(const char *data, unsigned long size)
+{
+    if (setjmp(m_error.jump)) {
+        jpeg_abort_decompress(&m_info);
+        return QSize();
+    }
+
+    jpeg_mem_src(&m_info, reinterpret_cast<unsigned char*>(const_cast<char*>(data)), size);
+
+    // Only the header is parsed, no pixels are decoded
+    auto ret = jpeg_read_header(&m_info, TRUE);
+    jpeg_abort_decompress(&m_info);
+
+    if (JPEG_HEADER_OK != ret)
+        return QSize();
+
+    return QSize(int(m_info.image_width), int(m_info.image_height));
+}
+
+QVideoFrame GPhotoPreviewDecoder::decodeRgb32(GPhotoVideoBufferPool &pool)
+{
+    // Objects with destructors are created before setjmp(), so longjmp() doesn't skip them
+    QByteArray buffer;
+
+    if (setjmp(m_error.jump)) {
+        jpeg_abort_decompress(&m_info);
+        return QVideoFrame();
+    }
+
+    m_info.out_color_space = outputColorSpace;
+
+    jpeg_start_decompress(&m_info);
+
+    // Scaled size is known only after decompression start
+    const QSize imageSize(int(m_info.output_width), int(m_info.output_height));
+    const auto &crop = cropRect(imageSize.width(), imageSize.height());
+    auto left = JDIMENSION(0);
+
+#ifdef LIBJPEG_TURBO_VERSION_NUMBER
+    // Decoded columns are widened to iMCU boundaries, output width becomes their width.
+    // Upsampled chroma of the border columns needs a column around them, or it differs from full decoding
+    if (crop.width() < imageSize.width()) {
+        const auto contextLeft = qMax(0, crop.left() - 1);
+        left = JDIMENSION(contextLeft);
+        auto width = JDIMENSION(qMin(imageSize.width(), crop.right() + 2) - contextLeft);
+        jpeg_crop_scanline(&m_info, &left, &width);
+    }
+
+    if (0 < crop.top())
+        jpeg_skip_scanlines(&m_info, JDIMENSION(crop.top()));
+#endif
+
+    // Decoded lines may start left of the crop, the frame starts at its first column
+    const auto offset = (crop.left() - int(left)) * outputBytesPerPixel;
+
+    // Lines are 32-bit aligned like QImage ones
+    auto bytesPerLine = (int(m_info.output_width) * outputBytesPerPixel + 3) & ~3;
+    buffer = pool.acquire(bytesPerLine * crop.height());
+    auto bits = reinterpret_cast<uchar*>(buffer.data());
+
+    // Lines above the crop which weren't skipped are decoded to scratch line
+    m_scratchLine.resize(bytesPerLine);
+    auto scratch = reinterpret_cast<JSAMPROW>(m_scratchLine.data());
+
+    const auto top = JDIMENSION(crop.top());
+    const auto bottom = JDIMENSION(crop.bottom() + 1);
+
+    JSAMPROW rows[maxRowsPerRead];
+    while (m_info.output_scanline < bottom) {
+        auto count = qMin(maxRowsPerRead, bottom - m_info.output_scanline);
+        for (auto i = 0U; i < count; ++i) {
+            const auto line = m_info.output_scanline + i;
+            rows[i] = (line < top) ? scratch : bits + (line - top) * unsigned(bytesPerLine);
+        }
+
+        jpeg_read_scanlines(&m_info, rows, count);
+    }
+
+    // Lines below the crop aren't decoded at all
+    if (m_info.output_scanline < m_info.output_height)
+        jpeg_abort_decompress(&m_info);
+    else
+        jpeg_finish_decompress(&m_info);
+
+    m_decodedRegion = QRectF(qreal(crop.x()) / imageSize.width(), qreal(crop.y()) / imageSize.height(),
+                             qreal(crop.width()) / imageSize.width(), qreal(crop.height()) / imageSize.height());
+
+    if (QImage::Format_RGB32 != outputFormat) {
+        // Conversion of plain libjpeg output costs an extra allocation per frame
+        const auto &image = QImage(bits + offset, crop.width(), crop.height(), bytesPerLine, outputFormat)
+                .convertToFormat(QImage::Format_RGB32);
+        pool.release(std::move(buffer));
+        return QVideoFrame(image);
+    }
+
+    auto videoBuffer = new GPhotoVideoBuffer(std::move(buffer), bytesPerLine, pool.shared_from_this(), offset);
+    return QVideoFrame(videoBuffer, crop.size(), QVideoFrame::Format_RGB32);
+}
+
+QVideoFrame GPhotoPreviewDecoder::decodeYuv420(GPhotoVideoBufferPool &pool)
+{
+    // Objects with destructors are created before setjmp(), so longjmp() doesn't skip them
+    QByteArray buffer;
+
+    if (setjmp(m_error.jump)) {
+        jpeg_abort_decompress(&m_info);
+        return QVideoFrame();
+    }
+
+    // Raw output gives the decoded planes as they are, without upsampling and colorspace conversion
+    m_info.raw_data_out = TRUE;
+    m_info.out_color_space = JCS_YCbCr;
+
+    jpeg_start_decompress(&m_info);
+
+    const auto *components = m_info.comp_info;
+    const auto &luma = components[0];
+    const auto &chroma = components[1];
+
+    // Chroma decoded at half of luma resolution both ways goes right into the planes,
+    // chroma decoded at luma resolution in some direction is halved afterwards
+    const auto chromaXStep = 2 / horizontalRatio(m_info, 1);
+    const auto chromaYStep = 2 / verticalRatio(m_info, 1);
+    const auto direct = (1 == chromaXStep && 1 == chromaYStep);
+
+    // Planes are written by whole blocks, lines have to hold the padding of luma and directly written chroma
+    const auto lumaWidth = int(luma.width_in_blocks) * dctScaledWidth(luma);
+    const auto chromaWidth = int(chroma.width_in_blocks) * dctScaledWidth(chroma);
+    const auto yStride = (qMax(lumaWidth, direct ? 2 * chromaWidth : 0) + 7) & ~7;
+    const auto uvStride = yStride / 2;
+
+    // YUV 4:2:0 frame needs even size
+    const QSize frameSize(int(m_info.output_width) & ~1, int(m_info.output_height) & ~1);
+    const auto yHeight = frameSize.height();
+    const auto uvHeight = yHeight / 2;
+
+    buffer = pool.acquire(yStride * yHeight + 2 * uvStride * uvHeight);
+    auto bits = reinterpret_cast<uchar*>(buffer.data());
+    uchar *const planes[] = {bits, bits + yStride * yHeight, bits + yStride * yHeight + uvStride * uvHeight};
+
+    // Rows below the frame are decoded to scratch line
+    m_scratchLine.resize(yStride);
+    auto scratch = reinterpret_cast<JSAMPROW>(m_scratchLine.data());
+
+    // Chroma to be halved is decoded whole first, a pair of its rows may span two reads
+    const auto chromaRows = int(m_info.total_iMCU_rows) * chroma.v_samp_factor * dctScaledHeight(chroma);
+    if (!direct)
+        m_scratchChroma.resize(2 * chromaWidth * chromaRows);
+    auto chromaBits = reinterpret_cast<uchar*>(m_scratchChroma.data());
+
+    JSAMPROW rows[3][maxRowsPerRead];
+    JSAMPARRAY image[] = {rows[0], rows[1], rows[2]};
+    const auto linesPerRead = JDIMENSION(m_info.max_v_samp_factor * minDctScaledHeight(m_info));
+
+    while (m_info.output_scanline < m_info.output_height) {
+        // Every read decodes one iMCU row, which holds v_samp_factor block rows of every component
+        const auto imcuRow = int(m_info.output_scanline / linesPerRead);
+
+        for (auto c = 0; c < 3; ++c) {
+            const auto &component = components[c];
+            const auto count = component.v_samp_factor * dctScaledHeight(component);
+            const auto first = imcuRow * count;
+
+            for (auto i = 0; i < count; ++i) {
+                const auto row = first + i;
+                if (0 == c)
+                    rows[c][i] = (row < yHeight) ? planes[c] + row * yStride : scratch;
+                else if (direct)
+                    rows[c][i] = (row < uvHeight) ? planes[c] + row * uvStride : scratch;
+                else
+                    rows[c][i] = chromaBits + ((c - 1) * chromaRows + row) * chromaWidth;
+            }
+        }
+
+        if (0 == jpeg_read_raw_data(&m_info, image, linesPerRead))
+            break;
+    }
+
+    jpeg_finish_decompress(&m_info);
+
+    if (!direct) {
+        for (auto c = 1; c < 3; ++c) {
+            halveChroma(chromaBits + (c - 1) * chromaRows * chromaWidth, chromaWidth, chromaXStep, chromaYStep,
+                        planes[c], uvStride, frameSize.width() / 2, uvHeight);
+        }
+    }
+
+    m_decodedRegion = fullRegion;
+
+    auto videoBuffer = new GPhotoVideoBuffer(std::move(buffer), yStride, pool.shared_from_this());
+    return QVideoFrame(videoBuffer, frameSize, QVideoFrame::Format_YUV420P);
+}
+
+bool GPhotoPreviewDecoder::canDecodeYuv420() const
+{
+    if (3 != m_info.num_components || JCS_YCbCr != m_info.jpeg_color_space)
+        return false;
+
+    const auto *components = m_info.comp_info;
+    if (components[1].h_samp_factor != components[2].h_samp_factor
+            || components[1].v_samp_factor != components[2].v_samp_factor
+            || dctScaledWidth(components[1]) != dctScaledWidth(components[2])
+            || dctScaledHeight(components[1]) != dctScaledHeight(components[2]))
+        return false;
+
+    // Every component has to fit its rows of an iMCU into the row buffers of decodeYuv420(),
+    // sampling factors come from the camera and JPEG allows up to 4 block rows per iMCU
+    for (auto i = 0; i < m_info.num_components; ++i) {
+        if (maxRowsPerRead < unsigned(components[i].v_samp_factor * dctScaledHeight(components[i])))
+            return false;
+    }
+
+    // Decoded chroma has to be at luma or half of luma resolution in each direction, other ratios
+    // would need resampling. Scaled sizes are known after jpeg_calc_output_dimensions()
+    const auto horizontal = horizontalRatio(m_info, 1);
+    const auto vertical = verticalRatio(m_info, 1);
+    return (1 == horizontal || 2 == horizontal) && (1 == vertical || 2 == vertical);
+}
+
+bool GPhotoPreviewDecoder::isJpeg(const char *data, unsigned long size)
+{
+    // JPEG stream starts with SOI marker
+    return size > 2 && '\xff' == data[0] && '\xd8' == data[1];
+}
+
+void GPhotoPreviewDecoder::errorExit(j_common_ptr info)
+{
+    char message[JMSG_LENGTH_MAX];
+    (*info->err->format_message)(info, message);
+    qWarning() << "GPhoto: Failed to decode preview:" << message;
+
+    std::longjmp(reinterpret_cast<ErrorManager*>(info->err)->jump, 1);
+}
+
+void GPhotoPreviewDecoder::outputMessage(j_common_ptr info)
+{
+    // Live view frames often come with minor corruptions, libjpeg warnings about them are just noise
+    Q_UNUSED(info)
+}
+
+unsigned int GPhotoPreviewDecoder::scaleDenominator(int width, int height) const
+{
+    if (m_targetSize.isEmpty() || width <= 0 || height <= 0)
+        return 1;
+
+    // Surface keeps aspect ratio, so frame has to cover the target only in the fitting direction
+    const auto &needed = QSize(width, height).scaled(m_targetSize, Qt::KeepAspectRatio);
+
+    for (auto denominator : {8, 4, 2}) {
+        // libjpeg rounds scaled size up
+        auto scaledWidth = (width + denominator - 1) / denominator;
+        auto scaledHeight = (height + denominator - 1) / denominator;
+        if (scaledWidth >= needed.width() && scaledHeight >= needed.height())
+            return unsigned(denominator);
+    }
+
+    return 1;
+}
+
+QRect GPhotoPreviewDecoder::cropRect(int width, int height) const
+{
+    const QRect bounds(0, 0, width, height);
+    if (m_crop.isNull())
+        return bounds;
+
+    // Crop is widened to whole pixels, a region thinner than a pixel still gets one
+    const auto &rect = QRectF(m_crop.x() * width, m_crop.y() * height, m_crop.width() * width, m_crop.height() * height)
+            .toAlignedRect().intersected(bounds);
+    return rect.isEmpty() ? bounds : rect;
+}
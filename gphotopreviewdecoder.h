@@ -0,0 +1,89 @@
+#ifndef GPHOTOPREVIEWDECODER_H
+#define GPHOTOPREVIEWDECODER_H
+
+#include <csetjmp>
+#include <cstdio>
+
+#include <QByteArray>
+#include <QRect>
+#include <QRectF>
+#include <QSize>
+#include <QVideoFrame>
+
+#include <jpeglib.h>
+
+class GPhotoVideoBufferPool;
+
+/** Decoder of live view JPEG frames.
+ *
+ * Frames are decoded with libjpeg DCT scaling, so only as many pixels as
+ * the target size needs are produced: the smallest of 1/8, 1/4, 1/2 or
+ * full scale that still covers the target. libjpeg-turbo decodes straight
+ * into RGB32 layout, plain libjpeg output is converted afterwards.
+ *
+ * YUV 4:2:0 frames are taken from libjpeg raw output, that is the decoded
+ * planes before upsampling and colorspace conversion. Scaled decoding
+ * upsamples chroma in IDCT, so chroma which comes out at luma resolution
+ * is averaged down to the 4:2:0 planes. It works for JPEGs with 4:2:0,
+ * 4:2:2 and 4:4:4 subsampling, others are decoded to RGB32.
+ *
+ * A crop limits decoding to a region of the image, the scale is chosen for
+ * the region then. libjpeg-turbo decodes only iMCU rows and columns which
+ * cover it (jpeg_crop_scanline() and jpeg_skip_scanlines()), plain libjpeg
+ * stops after the last row of the region at least. Raw planes can't be
+ * cropped, so cropped frames are always RGB32.
+ *
+ * Decompressor is created once and reused for every frame, pixels are
+ * written right into a pooled block which the returned frame maps.
+ */
+class GPhotoPreviewDecoder final
+{
+public:
+    GPhotoPreviewDecoder();
+    ~GPhotoPreviewDecoder();
+
+    GPhotoPreviewDecoder(GPhotoPreviewDecoder&&) = delete;
+    GPhotoPreviewDecoder& operator=(GPhotoPreviewDecoder&&) = delete;
+
+    QSize targetSize() const;
+    void setTargetSize(const QSize &size);
+
+    /// Region relative to image size, empty region means the whole image
+    QRectF crop() const;
+    void setCrop(const QRectF &region);
+    /// Region of the image the last decoded frame holds, relative to image size
+    QRectF decodedRegion() const;
+
+    QVideoFrame decode(const char *data, unsigned long size, QVideoFrame::PixelFormat format,
+                       GPhotoVideoBufferPool &pool);
+    QSize frameSize(const char *data, unsigned long size);
+
+    static bool isJpeg(const char *data, unsigned long size);
+
+private:
+    Q_DISABLE_COPY(GPhotoPreviewDecoder)
+
+    struct ErrorManager {
+        jpeg_error_mgr base;
+        std::jmp_buf jump;
+    };
+
+    static void errorExit(j_common_ptr info);
+    static void outputMessage(j_common_ptr info);
+
+    QVideoFrame decodeRgb32(GPhotoVideoBufferPool &pool);
+    QVideoFrame decodeYuv420(GPhotoVideoBufferPool &pool);
+    bool canDecodeYuv420() const;
+    unsigned int scaleDenominator(int width, int height) const;
+    QRect cropRect(int width, int height) const;
+
+    jpeg_decompress_struct m_info;
+    ErrorManager m_error;
+    QSize m_targetSize;
+    QRectF m_crop;
+    QRectF m_decodedRegion;
+    QByteArray m_scratchLine;
+    QByteArray m_scratchChroma;
+};
+
+#endif // GPHOTOPREVIEWDECODER_H
@@ -0,0 +1,333 @@
+#include <cstring>
+#include <mutex>
+
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QImage>
+#include <QMutexLocker>
+
+#include "gphotoexposurestatistics.h"
+#include "gphotofocusmeasure.h"
+#include "gphotopreviewworker.h"
+#include "gphotovideobuffer.h"
+#include "gphotovideobufferpool.h"
+
+const char *const GPhotoPreviewWorker::sequenceMetaData = "sequence";
+const char *const GPhotoPreviewWorker::cropMetaData = "crop";
+
+namespace {
+    // Queued compressed frames and decoded frames still held by surfaces and probes
+    constexpr auto extraBufferCount = 4;
+
+    // Compressed frames are decoded for statistics and motion alone at 1/8 scale, they need no more
+    const QSize statisticsSize(1, 1);
+
+    const QRectF fullRegion(0, 0, 1, 1);
+
+    // Region of the whole image is mapped into the cropped frame, it's cut off at the crop border
+    QRectF mapToCrop(const QRectF &region, const QRectF &crop)
+    {
+        const auto &visible = region.intersected(crop);
+        if (visible.isEmpty())
+            return QRectF();
+
+        return QRectF((visible.x() - crop.x()) / crop.width(), (visible.y() - crop.y()) / crop.height(),
+                      visible.width() / crop.width(), visible.height() / crop.height());
+    }
+}
+
+GPhotoPreviewWorker::GPhotoPreviewWorker(int index, int queueCapacity)
+    : m_queueCapacity(queueCapacity)
+    , m_bufferPool(std::make_shared<GPhotoVideoBufferPool>(queueCapacity + extraBufferCount))
+    , m_index(index)
+{
+}
+
+GPhotoPreviewWorker::~GPhotoPreviewWorker()
+{
+    if (0 != m_droppedFrames)
+        qDebug() << "GPhoto: Live view frames dropped by decoder:" << m_droppedFrames;
+}
+
+void GPhotoPreviewWorker::setIndex(int index)
+{
+    m_index.store(index);
+}
+
+void GPhotoPreviewWorker::setTargetSize(const QSize &size)
+{
+    QMutexLocker locker(&m_mutex);
+    m_targetSize = size;
+}
+
+void GPhotoPreviewWorker::setFormat(QVideoFrame::PixelFormat format)
+{
+    QMutexLocker locker(&m_mutex);
+    m_format = format;
+}
+
+void GPhotoPreviewWorker::setCrop(const QRectF &region)
+{
+    QMutexLocker locker(&m_mutex);
+    m_crop = region;
+}
+
+void GPhotoPreviewWorker::setStatisticsEnabled(bool enabled)
+{
+    QMutexLocker locker(&m_mutex);
+    m_statisticsEnabled = enabled;
+}
+
+void GPhotoPreviewWorker::setFocusMeasurement(const QRectF &region, int peakingThreshold)
+{
+    QMutexLocker locker(&m_mutex);
+    m_focusRegion = region;
+    m_peakingThreshold = peakingThreshold;
+}
+
+void GPhotoPreviewWorker::setMotionDetection(const QVector<QRectF> &regions, int threshold, int cooldown)
+{
+    QMutexLocker locker(&m_mutex);
+    m_motionRegions = regions;
+    m_motionThreshold = threshold;
+    m_motionCooldown = cooldown;
+}
+
+void GPhotoPreviewWorker::holdMotionDetection()
+{
+    const auto now = clock();
+
+    QMutexLocker locker(&m_mutex);
+    m_motionResetPending = true;
+    m_motionHoldTime = now;
+}
+
+qint64 GPhotoPreviewWorker::clock()
+{
+    static QElapsedTimer timer;
+    static std::once_flag started;
+    std::call_once(started, [] { timer.start(); });
+
+    return timer.nsecsElapsed() / 1000;
+}
+
+void GPhotoPreviewWorker::enqueue(const char *data, unsigned long size, qint64 timestamp)
+{
+    // Camera file is reused for the next frame, so data is copied to a pooled block
+    PendingFrame frame;
+    frame.data = m_bufferPool->acquire(int(size));
+    frame.timestamp = timestamp;
+    memcpy(frame.data.data(), data, size);
+
+    QMutexLocker locker(&m_mutex);
+
+    if (m_queue.size() >= m_queueCapacity) {
+        m_bufferPool->release(std::move(m_queue.dequeue().data));
+        ++m_droppedFrames;
+    }
+
+    // Dropped frames leave gaps in sequence numbers, so consumers may count them
+    frame.sequence = m_sequence++;
+    m_queue.enqueue(std::move(frame));
+
+    if (!m_decodeScheduled) {
+        m_decodeScheduled = true;
+        QMetaObject::invokeMethod(this, "decodePending", Qt::QueuedConnection);
+    }
+}
+
+void GPhotoPreviewWorker::clear()
+{
+    QMutexLocker locker(&m_mutex);
+
+    while (!m_queue.isEmpty())
+        m_bufferPool->release(std::move(m_queue.dequeue().data));
+
+    m_framesInFlight = 0;
+
+    // Live view restarts after clear(), the last frame before it is no reference
+    m_motionResetPending = true;
+}
+
+int GPhotoPreviewWorker::pendingFrames()
+{
+    QMutexLocker locker(&m_mutex);
+    return m_queue.size() + m_framesInFlight;
+}
+
+void GPhotoPreviewWorker::framesConsumed(int count)
+{
+    QMutexLocker locker(&m_mutex);
+
+    // Frames emitted before clear() may be acknowledged after it
+    m_framesInFlight = qMax(0, m_framesInFlight - count);
+}
+
+void GPhotoPreviewWorker::decodePending()
+{
+    forever {
+        PendingFrame pending;
+        QSize targetSize;
+        auto format = QVideoFrame::Format_RGB32;
+        QRectF crop;
+        auto statisticsEnabled = false;
+        QRectF focusRegion;
+        auto peakingThreshold = 0;
+        QVector<QRectF> motionRegions;
+
+        {
+            QMutexLocker locker(&m_mutex);
+            if (m_queue.isEmpty()) {
+                m_decodeScheduled = false;
+                return;
+            }
+
+            pending = m_queue.dequeue();
+            targetSize = m_targetSize;
+            format = m_format;
+            crop = m_crop;
+            statisticsEnabled = m_statisticsEnabled;
+            focusRegion = m_focusRegion;
+            peakingThreshold = m_peakingThreshold;
+            motionRegions = m_motionRegions;
+
+            // Detector is used by the decode thread only, settings are applied here while they can't change
+            m_motionDetector.setThreshold(m_motionThreshold);
+            m_motionDetector.setCooldown(m_motionCooldown);
+
+            if (m_motionResetPending) {
+                m_motionDetector.reset();
+                m_motionResetPending = false;
+            }
+
+            if (0 <= m_motionHoldTime) {
+                m_motionDetector.hold(m_motionHoldTime);
+                m_motionHoldTime = -1;
+            }
+        }
+
+        QRectF region;
+        auto frame = decode(std::move(pending.data), targetSize, format, crop, &region);
+        if (!frame.isValid())
+            continue;
+
+        frame.setStartTime(pending.timestamp);
+        frame.setMetaData(QLatin1String(sequenceMetaData), pending.sequence);
+
+        if (fullRegion != region) {
+            frame.setMetaData(QLatin1String(cropMetaData), region);
+
+            // Regions are given for the whole image
+            focusRegion = mapToCrop(focusRegion, region);
+            for (auto &motionRegion : motionRegions)
+                motionRegion = mapToCrop(motionRegion, region);
+        }
+
+        // Moved crop shows another scene, its frames can't be compared with the old ones
+        if (m_decodedRegion != region) {
+            m_decodedRegion = region;
+            m_motionDetector.reset();
+        }
+        m_motionDetector.setRegions(motionRegions);
+
+        const auto measureFocus = !focusRegion.isEmpty() || 0 < peakingThreshold;
+        if (statisticsEnabled || measureFocus || m_motionDetector.isEnabled()) {
+            // Focus needs full detail of luma alone. Statistics are fine with the smallest scale,
+            // libjpeg converts it to RGB for the colour histograms
+            const auto &pixels = measureFocus ? pixelFrame(frame, QSize(), QVideoFrame::Format_YUV420P)
+                                              : pixelFrame(frame, statisticsSize, QVideoFrame::Format_RGB32);
+
+            if (statisticsEnabled) {
+                const auto &statistics = GPhotoExposureStatistics::analyze(pixels);
+                if (statistics.isValid())
+                    frame.setMetaData(QLatin1String(GPhotoExposureStatistics::metaDataKey),
+                                      QVariant::fromValue(statistics));
+            }
+
+            if (!focusRegion.isEmpty()) {
+                const auto sharpness = GPhotoFocusMeasure::sharpness(pixels, focusRegion);
+                if (0 <= sharpness)
+                    frame.setMetaData(QLatin1String(GPhotoFocusMeasure::sharpnessMetaDataKey), sharpness);
+            }
+
+            if (0 < peakingThreshold) {
+                const auto &mask = GPhotoFocusMeasure::peakingMask(pixels, peakingThreshold);
+                if (!mask.isNull())
+                    frame.setMetaData(QLatin1String(GPhotoFocusMeasure::peakingMetaDataKey), mask);
+            }
+
+            if (m_motionDetector.isEnabled()) {
+                auto changedRatio = qreal(0);
+                if (m_motionDetector.process(pixels, pending.timestamp, &changedRatio))
+                    emit motionDetected(m_index.load(), pending.timestamp);
+
+                if (0 <= changedRatio)
+                    frame.setMetaData(QLatin1String(GPhotoMotionDetector::metaDataKey), changedRatio);
+            }
+        }
+
+        {
+            QMutexLocker locker(&m_mutex);
+            ++m_framesInFlight;
+        }
+
+        emit frameDecoded(m_index.load(), frame);
+    }
+}
+
+QVideoFrame GPhotoPreviewWorker::decode(QByteArray data, const QSize &targetSize, QVideoFrame::PixelFormat format,
+                                        const QRectF &crop, QRectF *region)
+{
+    *region = fullRegion;
+
+    // Some drivers may give live view in other formats, let Qt detect them
+    if (!GPhotoPreviewDecoder::isJpeg(data.constData(), ulong(data.size()))) {
+        const auto &image = QImage::fromData(data);
+        m_bufferPool->release(std::move(data));
+        return QVideoFrame(image);
+    }
+
+    if (QVideoFrame::Format_Jpeg == format) {
+        const auto &frameSize = m_decoder.frameSize(data.constData(), ulong(data.size()));
+        if (!frameSize.isValid()) {
+            m_bufferPool->release(std::move(data));
+            return QVideoFrame();
+        }
+
+        // Compressed block itself becomes the frame buffer
+        auto bytesPerLine = data.size();
+        auto videoBuffer = new GPhotoVideoBuffer(std::move(data), bytesPerLine, m_bufferPool);
+        return QVideoFrame(videoBuffer, frameSize, QVideoFrame::Format_Jpeg);
+    }
+
+    m_decoder.setTargetSize(targetSize);
+    m_decoder.setCrop(crop);
+    const auto &frame = m_decoder.decode(data.constData(), ulong(data.size()), format, *m_bufferPool);
+    m_bufferPool->release(std::move(data));
+
+    if (frame.isValid())
+        *region = m_decoder.decodedRegion();
+
+    return frame;
+}
+
+QVideoFrame GPhotoPreviewWorker::pixelFrame(const QVideoFrame &frame, const QSize &targetSize,
+                                            QVideoFrame::PixelFormat format)
+{
+    if (QVideoFrame::Format_Jpeg != frame.pixelFormat())
+        return frame;
+
+    // Mapping doesn't change the frame, a copy shares the same buffer
+    QVideoFrame source(frame);
+    if (!source.map(QAbstractVideoBuffer::ReadOnly))
+        return QVideoFrame();
+
+    // Compressed frames are never cropped, see decode()
+    m_decoder.setTargetSize(targetSize);
+    m_decoder.setCrop(QRectF());
+    const auto &decoded = m_decoder.decode(reinterpret_cast<const char*>(source.bits()), ulong(source.mappedBytes()),
+                                           format, *m_bufferPool);
+    source.unmap();
+
+    return decoded;
+}
@@ -0,0 +1,129 @@
+#ifndef GPHOTOPREVIEWWORKER_H
+#define GPHOTOPREVIEWWORKER_H
+
+#include <memory>
+
+#include <QAtomicInt>
+#include <QMutex>
+#include <QObject>
+#include <QQueue>
+#include <QRectF>
+#include <QSize>
+#include <QVector>
+#include <QVideoFrame>
+
+#include "gphotomotiondetector.h"
+#include "gphotopreviewdecoder.h"
+
+class GPhotoVideoBufferPool;
+
+/** Decode stage of the live view pipeline.
+ *
+ * Camera thread only fetches compressed frames and queues them here, while
+ * this object decodes them in its own thread, so USB transfer of the next
+ * frame overlaps decoding of the previous one. The queue is bounded: when
+ * decoding falls behind, the oldest queued frame is dropped to keep live
+ * view latency low.
+ *
+ * Frames are queued and settings are changed from camera thread, decoded
+ * frames are emitted from the decode thread. Emitted frames are counted as
+ * pending until their consumer acknowledges them, so camera can stop
+ * fetching when nobody takes the frames.
+ *
+ * Every frame carries the clock() time its transfer completed as start
+ * time and its fetch sequence number as "sequence" meta data. While
+ * statistics are enabled it also carries GPhotoExposureStatistics, and
+ * while focus is measured it carries GPhotoFocusMeasure results. Pixels
+ * of compressed frames are decoded for them separately.
+ *
+ * While motion detection is on, every frame is also compared with the
+ * previous one by GPhotoMotionDetector, its changed part goes to "motion"
+ * meta data and motionDetected() is emitted from the decode thread before
+ * the frame itself.
+ *
+ * Cropped frames hold only a region of the image, given by "crop" meta
+ * data. Statistics, focus and motion see the cropped frame, focus and
+ * motion regions are mapped into it.
+ */
+class GPhotoPreviewWorker final : public QObject
+{
+    Q_OBJECT
+public:
+    static const char *const sequenceMetaData;
+    static const char *const cropMetaData;
+
+    GPhotoPreviewWorker(int index, int queueCapacity);
+    ~GPhotoPreviewWorker();
+
+    GPhotoPreviewWorker(GPhotoPreviewWorker&&) = delete;
+    GPhotoPreviewWorker& operator=(GPhotoPreviewWorker&&) = delete;
+
+    void setIndex(int index);
+    void setTargetSize(const QSize &size);
+    void setFormat(QVideoFrame::PixelFormat format);
+    /// Region relative to image size, empty region means the whole image, see GPhotoPreviewDecoder
+    void setCrop(const QRectF &region);
+    void setStatisticsEnabled(bool enabled);
+    /// Empty region and zero threshold turn sharpness and peaking off
+    void setFocusMeasurement(const QRectF &region, int peakingThreshold);
+    /// Zero threshold turns motion detection off, see GPhotoMotionDetector
+    void setMotionDetection(const QVector<QRectF> &regions, int threshold, int cooldown);
+    /// Drops motion reference frame and holds triggers for cooldown from now, live view changes after a capture
+    void holdMotionDetection();
+
+    /// Monotonic time in microseconds, common for all threads
+    static qint64 clock();
+
+    void enqueue(const char *data, unsigned long size, qint64 timestamp);
+    void clear();
+
+    int pendingFrames();
+    void framesConsumed(int count);
+
+signals:
+    void frameDecoded(int index, const QVideoFrame &frame);
+    void motionDetected(int index, qint64 timestamp);
+
+private slots:
+    void decodePending();
+
+private:
+    Q_DISABLE_COPY(GPhotoPreviewWorker)
+
+    struct PendingFrame {
+        QByteArray data;
+        qint64 timestamp = 0;
+        quint64 sequence = 0;
+    };
+
+    QVideoFrame decode(QByteArray data, const QSize &targetSize, QVideoFrame::PixelFormat format,
+                       const QRectF &crop, QRectF *region);
+    QVideoFrame pixelFrame(const QVideoFrame &frame, const QSize &targetSize, QVideoFrame::PixelFormat format);
+
+    const int m_queueCapacity;
+    std::shared_ptr<GPhotoVideoBufferPool> m_bufferPool;
+    GPhotoPreviewDecoder m_decoder;
+    GPhotoMotionDetector m_motionDetector;
+    QAtomicInt m_index;
+
+    QMutex m_mutex;
+    QQueue<PendingFrame> m_queue;
+    QSize m_targetSize;
+    QVideoFrame::PixelFormat m_format = QVideoFrame::Format_RGB32;
+    QRectF m_crop;
+    bool m_decodeScheduled = false;
+    bool m_statisticsEnabled = false;
+    QRectF m_focusRegion;
+    int m_peakingThreshold = 0;
+    QVector<QRectF> m_motionRegions;
+    int m_motionThreshold = 0;
+    int m_motionCooldown = 0;
+    qint64 m_motionHoldTime = -1;
+    bool m_motionResetPending = false;
+    QRectF m_decodedRegion;
+    int m_framesInFlight = 0;
+    quint64 m_droppedFrames = 0;
+    quint64 m_sequence = 0;
+};
+
+#endif // GPHOTOPREVIEWWORKER_H
@@ -0,0 +1,47 @@
+#include "gphotovideobuffer.h"
+#include "gphotovideobufferpool.h"
+
+GPhotoVideoBuffer::GPhotoVideoBuffer(QByteArray data, int bytesPerLine, std::weak_ptr<GPhotoVideoBufferPool> pool,
+                                     int offset)
+    : QAbstractVideoBuffer(NoHandle)
+    , m_data(std::move(data))
+    , m_bytesPerLine(bytesPerLine)
+    , m_offset(offset)
+    , m_pool(std::move(pool))
+{
+}
+
+GPhotoVideoBuffer::~GPhotoVideoBuffer()
+{
+    // Pool may be already gone with its camera while frame was still in use
+    if (const auto &pool = m_pool.lock())
+        pool->release(std::move(m_data));
+}
+
+QAbstractVideoBuffer::MapMode GPhotoVideoBuffer::mapMode() const
+{
+    return m_mapMode;
+}
+
+uchar* GPhotoVideoBuffer::map(MapMode mode, int *numBytes, int *bytesPerLine)
+{
+    if (NotMapped != m_mapMode || NotMapped == mode || m_data.size() <= m_offset)
+        return nullptr;
+
+    m_mapMode = mode;
+
+    if (numBytes)
+        *numBytes = m_data.size() - m_offset;
+
+    if (bytesPerLine)
+        *bytesPerLine = m_bytesPerLine;
+
+    // Data is detached only if a sink wants to write to it
+    return (mode & WriteOnly) ? reinterpret_cast<uchar*>(m_data.data()) + m_offset
+                              : reinterpret_cast<uchar*>(const_cast<char*>(m_data.constData())) + m_offset;
+}
+
+void GPhotoVideoBuffer::unmap()
+{
+    m_mapMode = NotMapped;
+}
@@ -0,0 +1,44 @@
+#ifndef GPHOTOVIDEOBUFFER_H
+#define GPHOTOVIDEOBUFFER_H
+
+#include <memory>
+
+#include <QAbstractVideoBuffer>
+#include <QByteArray>
+
+class GPhotoVideoBufferPool;
+
+/** Video buffer over data already held in a byte array.
+ *
+ * Used for live view frames, both decoded and compressed ones, which are
+ * decoded only by a sink mapping them. Data taken from a pool goes back
+ * there when the last frame referring to the buffer is destroyed.
+ *
+ * Frame may start at an offset in the data, so a crop of wider decoded
+ * lines is mapped without a copy.
+ */
+class GPhotoVideoBuffer final : public QAbstractVideoBuffer
+{
+public:
+    GPhotoVideoBuffer(QByteArray data, int bytesPerLine, std::weak_ptr<GPhotoVideoBufferPool> pool = {},
+                      int offset = 0);
+    ~GPhotoVideoBuffer();
+
+    GPhotoVideoBuffer(GPhotoVideoBuffer&&) = delete;
+    GPhotoVideoBuffer& operator=(GPhotoVideoBuffer&&) = delete;
+
+    MapMode mapMode() const final;
+    uchar* map(MapMode mode, int *numBytes, int *bytesPerLine) final;
+    void unmap() final;
+
+private:
+    Q_DISABLE_COPY(GPhotoVideoBuffer)
+
+    QByteArray m_data;
+    int m_bytesPerLine;
+    int m_offset;
+    std::weak_ptr<GPhotoVideoBufferPool> m_pool;
+    MapMode m_mapMode = NotMapped;
+};
+
+#endif // GPHOTOVIDEOBUFFER_H
@@ -0,0 +1,49 @@
+#include <QMutexLocker>
+
+#include "gphotovideobufferpool.h"
+
+GPhotoVideoBufferPool::GPhotoVideoBufferPool(int maxFreeBuffers)
+    : m_maxFreeBuffers(maxFreeBuffers)
+{
+    m_freeBuffers.reserve(maxFreeBuffers);
+}
+
+QByteArray GPhotoVideoBufferPool::acquire(int size)
+{
+    QByteArray data;
+
+    {
+        QMutexLocker locker(&m_mutex);
+
+        // Prefer a block which is large enough already, resizing it doesn't reallocate
+        auto index = m_freeBuffers.size() - 1;
+        for (auto i = 0; i < m_freeBuffers.size(); ++i) {
+            if (m_freeBuffers.at(i).capacity() >= size) {
+                index = i;
+                break;
+            }
+        }
+
+        if (index >= 0) {
+            data = std::move(m_freeBuffers[index]);
+            m_freeBuffers.remove(index);
+        }
+    }
+
+    if (data.isNull())
+        return QByteArray(size, Qt::Uninitialized);
+
+    data.resize(size);
+    return data;
+}
+
+void GPhotoVideoBufferPool::release(QByteArray &&data)
+{
+    // Block is still shared by somebody, reusing it would only detach it
+    if (!data.isDetached())
+        return;
+
+    QMutexLocker locker(&m_mutex);
+    if (m_freeBuffers.size() < m_maxFreeBuffers)
+        m_freeBuffers.append(std::move(data));
+}
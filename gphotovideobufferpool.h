@@ -0,0 +1,37 @@
+#ifndef GPHOTOVIDEOBUFFERPOOL_H
+#define GPHOTOVIDEOBUFFERPOOL_H
+
+#include <memory>
+
+#include <QByteArray>
+#include <QMutex>
+#include <QVector>
+
+/** Pool of memory blocks for live view frames.
+ *
+ * Frames are decoded into blocks taken from the pool and the blocks come
+ * back when the last video frame referring to them is released, so the
+ * preview loop doesn't allocate frame memory once it reaches a steady
+ * state. Blocks may be released from any thread.
+ */
+class GPhotoVideoBufferPool final : public std::enable_shared_from_this<GPhotoVideoBufferPool>
+{
+public:
+    explicit GPhotoVideoBufferPool(int maxFreeBuffers);
+    ~GPhotoVideoBufferPool() = default;
+
+    GPhotoVideoBufferPool(GPhotoVideoBufferPool&&) = delete;
+    GPhotoVideoBufferPool& operator=(GPhotoVideoBufferPool&&) = delete;
+
+    QByteArray acquire(int size);
+    void release(QByteArray &&data);
+
+private:
+    Q_DISABLE_COPY(GPhotoVideoBufferPool)
+
+    const int m_maxFreeBuffers;
+    QVector<QByteArray> m_freeBuffers;
+    QMutex m_mutex;
+};
+
+#endif // GPHOTOVIDEOBUFFERPOOL_H
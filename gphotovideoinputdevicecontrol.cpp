@@ -5,21 +5,24 @@ GPhotoVideoInputDeviceControl::GPhotoVideoInputDeviceControl(GPhotoCameraSession
     : QVideoDeviceSelectorControl(parent)
     , m_session(session)
 {
+    // QCamera looks the device up right after the control is created, so names have to be ready here
+    m_cameraNames = m_session->cameraNames();
 }
 
 int GPhotoVideoInputDeviceControl::deviceCount() const
 {
-    return m_session->cameraNames().size();
+    updateCameraNames();
+    return m_cameraNames.size();
 }
 
 QString GPhotoVideoInputDeviceControl::deviceName(int index) const
 {
-    return m_session->cameraNames().value(index);
+    return m_cameraNames.value(index);
 }
 
 QString GPhotoVideoInputDeviceControl::deviceDescription(int index) const
 {
-    return m_session->cameraNames().value(index);
+    return m_cameraNames.value(index);
 }
 
 int GPhotoVideoInputDeviceControl::defaultDevice() const
@@ -41,3 +44,20 @@ void GPhotoVideoInputDeviceControl::setSelectedDevice(int index)
         emit selectedDeviceChanged(deviceName(index));
     }
 }
+
+void GPhotoVideoInputDeviceControl::updateCameraNames() const
+{
+    if (m_updatePending)
+        return;
+
+    m_updatePending = true;
+
+    auto control = const_cast<GPhotoVideoInputDeviceControl*>(this);
+    m_session->cameraNames(control, [control] (const QList<QByteArray> &names) {
+        control->m_updatePending = false;
+        if (control->m_cameraNames != names) {
+            control->m_cameraNames = names;
+            emit control->devicesChanged();
+        }
+    });
+}
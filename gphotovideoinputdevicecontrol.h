@@ -29,8 +29,12 @@ public slots:
 private:
     Q_DISABLE_COPY(GPhotoVideoInputDeviceControl)
 
+    void updateCameraNames() const;
+
     int m_selectedDevice = -1;
     GPhotoCameraSession *const m_session;
+    mutable QList<QByteArray> m_cameraNames;
+    mutable bool m_updatePending = false;
 };
 
 #endif // GPHOTOVIDEOINPUTDEVICECONTROL_H
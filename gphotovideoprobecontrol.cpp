@@ -1,6 +1,44 @@
+#include <QBuffer>
+#include <QImage>
+#include <QImageReader>
+#include <QMetaMethod>
+
 #include "gphotocamerasession.h"
 #include "gphotovideoprobecontrol.h"
 
+namespace {
+    QVideoFrame decimateYuv420(const QVideoFrame &source, const QSize &size)
+    {
+        // YUV 4:2:0 frame needs even size
+        const QSize frameSize(qMax(2, size.width() & ~1), qMax(2, size.height() & ~1));
+        const auto width = frameSize.width();
+        const auto height = frameSize.height();
+
+        QVideoFrame result(width * height * 3 / 2, frameSize, width, QVideoFrame::Format_YUV420P);
+        if (!result.map(QAbstractVideoBuffer::WriteOnly))
+            return QVideoFrame();
+
+        // Nearest neighbour is enough for analytics, it touches only the pixels it keeps
+        for (auto plane = 0; plane < 3; ++plane) {
+            const auto shift = (0 == plane) ? 0 : 1;
+            const auto sourceWidth = source.width() >> shift;
+            const auto sourceHeight = source.height() >> shift;
+            const auto planeWidth = width >> shift;
+            const auto planeHeight = height >> shift;
+
+            for (auto y = 0; y < planeHeight; ++y) {
+                const auto *sourceLine = source.bits(plane) + y * sourceHeight / planeHeight * source.bytesPerLine(plane);
+                auto *line = result.bits(plane) + y * result.bytesPerLine(plane);
+                for (auto x = 0; x < planeWidth; ++x)
+                    line[x] = sourceLine[x * sourceWidth / planeWidth];
+            }
+        }
+
+        result.unmap();
+        return result;
+    }
+}
+
 GPhotoVideoProbeControl::GPhotoVideoProbeControl(GPhotoCameraSession *session, QObject *parent)
     : QMediaVideoProbeControl(parent)
     , m_session(session)
@@ -8,5 +46,100 @@ GPhotoVideoProbeControl::GPhotoVideoProbeControl(GPhotoCameraSession *session, Q
     using Session = GPhotoCameraSession;
     using Control = GPhotoVideoProbeControl;
 
-    connect(m_session, &Session::videoFrameProbed, this, &Control::videoFrameProbed);
+    connect(m_session, &Session::videoFrameProbed, this, &Control::onVideoFrameProbed);
+    m_session->attachProbe();
+}
+
+GPhotoVideoProbeControl::~GPhotoVideoProbeControl()
+{
+    if (m_session)
+        m_session->detachProbe();
+}
+
+qreal GPhotoVideoProbeControl::maximumFrameRate() const
+{
+    return m_session ? m_session->probeFrameRate() : 0;
+}
+
+void GPhotoVideoProbeControl::setMaximumFrameRate(qreal frameRate)
+{
+    if (m_session)
+        m_session->setProbeFrameRate(frameRate);
+}
+
+QSize GPhotoVideoProbeControl::maximumSize() const
+{
+    return m_session ? m_session->probeFrameSize() : QSize();
+}
+
+void GPhotoVideoProbeControl::setMaximumSize(const QSize &size)
+{
+    if (m_session)
+        m_session->setProbeFrameSize(size);
+}
+
+void GPhotoVideoProbeControl::onVideoFrameProbed(const QVideoFrame &frame)
+{
+    // Control may be requested without a probe listening to it
+    if (!isSignalConnected(QMetaMethod::fromSignal(&GPhotoVideoProbeControl::videoFrameProbed)))
+        return;
+
+    // Frames come from the session, so it's still there
+    const auto maximumFrameRate = m_session->probeFrameRate();
+    if (0 < maximumFrameRate && m_frameTimer.isValid()
+            && m_frameTimer.elapsed() < qint64(1000 / maximumFrameRate))
+        return;
+
+    m_frameTimer.start();
+
+    const auto &result = downscaled(frame, m_session->probeFrameSize());
+    if (result.isValid())
+        emit videoFrameProbed(result);
+}
+
+QVideoFrame GPhotoVideoProbeControl::downscaled(const QVideoFrame &frame, const QSize &maximumSize) const
+{
+    if (maximumSize.isEmpty()
+            || (frame.width() <= maximumSize.width() && frame.height() <= maximumSize.height()))
+        return frame;
+
+    const auto &size = frame.size().scaled(maximumSize, Qt::KeepAspectRatio);
+
+    // Mapping doesn't change the frame, a copy shares the same buffer
+    QVideoFrame source(frame);
+    if (!source.map(QAbstractVideoBuffer::ReadOnly))
+        return QVideoFrame();
+
+    QVideoFrame result;
+    if (QVideoFrame::Format_YUV420P == source.pixelFormat()) {
+        result = decimateYuv420(source, size);
+    } else if (QVideoFrame::Format_Jpeg == source.pixelFormat()) {
+        // Qt JPEG reader decodes at reduced scale right away
+        auto data = QByteArray::fromRawData(reinterpret_cast<const char*>(source.bits()), source.mappedBytes());
+        QBuffer buffer(&data);
+        QImageReader reader(&buffer, "jpeg");
+        reader.setScaledSize(size);
+
+        const auto &image = reader.read();
+        if (!image.isNull())
+            result = QVideoFrame(image);
+    } else {
+        const auto format = QVideoFrame::imageFormatFromPixelFormat(source.pixelFormat());
+        if (QImage::Format_Invalid != format) {
+            const QImage image(source.bits(), source.width(), source.height(), source.bytesPerLine(), format);
+            result = QVideoFrame(image.scaled(size, Qt::IgnoreAspectRatio, Qt::FastTransformation));
+        }
+    }
+
+    source.unmap();
+
+    if (!result.isValid())
+        return QVideoFrame();
+
+    result.setStartTime(frame.startTime());
+    const auto &metaData = frame.availableMetaData();
+    for (auto it = metaData.cbegin(); it != metaData.cend(); ++it)
+        result.setMetaData(it.key(), it.value());
+
+    return result;
 }
@@ -1,24 +1,54 @@
 #ifndef GPHOTOVIDEOPROBECONTROL_H
 #define GPHOTOVIDEOPROBECONTROL_H
 
+#include <QElapsedTimer>
 #include <QMediaVideoProbeControl>
+#include <QPointer>
+#include <QSize>
 
 class GPhotoCameraSession;
 
+/** Live view probe.
+ *
+ * Session delivers frames to probes only while some probe control exists,
+ * so live view costs nothing extra without probes. Frame rate and frame
+ * size of probed frames may be limited by "maximumFrameRate" and
+ * "maximumSize" properties, then frames are skipped and downscaled copies
+ * are made for probes, the viewfinder keeps getting full frames.
+ *
+ * QVideoProbe requests a control of its own, so the limits are kept by the
+ * session and apply to every probe control of the camera, whichever one
+ * they are set on.
+ */
 class GPhotoVideoProbeControl final : public QMediaVideoProbeControl
 {
     Q_OBJECT
+    Q_PROPERTY(qreal maximumFrameRate READ maximumFrameRate WRITE setMaximumFrameRate)
+    Q_PROPERTY(QSize maximumSize READ maximumSize WRITE setMaximumSize)
 public:
     explicit GPhotoVideoProbeControl(GPhotoCameraSession *session, QObject *parent = nullptr);
-    ~GPhotoVideoProbeControl() = default;
+    ~GPhotoVideoProbeControl();
 
     GPhotoVideoProbeControl(GPhotoVideoProbeControl&&) = delete;
     GPhotoVideoProbeControl& operator=(GPhotoVideoProbeControl&&) = delete;
 
+    // zero rate and empty size mean no limit
+    qreal maximumFrameRate() const;
+    void setMaximumFrameRate(qreal frameRate);
+    QSize maximumSize() const;
+    void setMaximumSize(const QSize &size);
+
+private slots:
+    void onVideoFrameProbed(const QVideoFrame &frame);
+
 private:
     Q_DISABLE_COPY(GPhotoVideoProbeControl)
 
-    GPhotoCameraSession *const m_session;
+    QVideoFrame downscaled(const QVideoFrame &frame, const QSize &maximumSize) const;
+
+    // Controls may outlive session when service is destroyed
+    const QPointer<GPhotoCameraSession> m_session;
+    QElapsedTimer m_frameTimer;
 };
 
 #endif // GPHOTOVIDEOPROBECONTROL_H
@@ -0,0 +1,106 @@
+#include <iterator>
+#include <numeric>
+
+#include "gphotocamerasession.h"
+#include "gphotoviewfindersettingscontrol.h"
+
+GPhotoViewfinderSettingsControl::GPhotoViewfinderSettingsControl(GPhotoCameraSession *session, QObject *parent)
+    : QCameraViewfinderSettingsControl2(parent)
+    , m_session(session)
+{
+    using Session = GPhotoCameraSession;
+    using Control = GPhotoViewfinderSettingsControl;
+
+    connect(m_session, &Session::previewStatisticsChanged, this, &Control::previewStatisticsChanged);
+}
+
+QList<QCameraViewfinderSettings> GPhotoViewfinderSettingsControl::supportedViewfinderSettings() const
+{
+    // Live view resolution and rate are given by camera, only decode size and frame rate cap may be set
+    return {};
+}
+
+QCameraViewfinderSettings GPhotoViewfinderSettingsControl::viewfinderSettings() const
+{
+    QCameraViewfinderSettings settings;
+    settings.setResolution(m_session->previewResolution());
+    settings.setMaximumFrameRate(m_session->previewFrameRate());
+    return settings;
+}
+
+void GPhotoViewfinderSettingsControl::setViewfinderSettings(const QCameraViewfinderSettings &settings)
+{
+    m_session->setPreviewResolution(settings.resolution());
+    m_session->setPreviewFrameRate(settings.maximumFrameRate());
+}
+
+QRectF GPhotoViewfinderSettingsControl::crop() const
+{
+    return m_session->previewCrop();
+}
+
+void GPhotoViewfinderSettingsControl::setCrop(const QRectF &region)
+{
+    m_session->setPreviewCrop(region);
+}
+
+int GPhotoViewfinderSettingsControl::focusPeakingThreshold() const
+{
+    return m_session->focusPeakingThreshold();
+}
+
+void GPhotoViewfinderSettingsControl::setFocusPeakingThreshold(int threshold)
+{
+    m_session->setFocusPeakingThreshold(threshold);
+}
+
+QString GPhotoViewfinderSettingsControl::frameExport() const
+{
+    return m_session->frameExportName();
+}
+
+bool GPhotoViewfinderSettingsControl::startFrameExport(const QString &name, int slotCount, int slotSize)
+{
+    return m_session->startFrameExport(name, slotCount, slotSize);
+}
+
+void GPhotoViewfinderSettingsControl::stopFrameExport()
+{
+    m_session->stopFrameExport();
+}
+
+QVariantMap GPhotoViewfinderSettingsControl::previewStatistics() const
+{
+    using Statistics = GPhotoCameraSession::PreviewStatistics;
+    const auto &statistics = m_session->previewStatistics();
+
+    // Latency histogram goes with upper bounds of its buckets, the last bucket has none
+    QVariantList histogram;
+    QVariantList bounds;
+    for (auto i = 0; i < Statistics::LatencyBucketCount; ++i) {
+        histogram.append(statistics.latencyHistogram[i]);
+        if (i < Statistics::LatencyBucketCount - 1)
+            bounds.append(Statistics::latencyBounds[i]);
+    }
+
+    const auto latencyCount = std::accumulate(std::begin(statistics.latencyHistogram),
+                                               std::end(statistics.latencyHistogram), quint64(0));
+
+    // Session measures latency in microseconds
+    QVariantMap result;
+    result.insert(QStringLiteral("deliveredFrames"), statistics.deliveredFrames);
+    result.insert(QStringLiteral("droppedFrames"), statistics.droppedFrames);
+    result.insert(QStringLiteral("deliveredFrameRate"), statistics.deliveredFrameRate);
+    result.insert(QStringLiteral("droppedFrameRate"), statistics.droppedFrameRate);
+    result.insert(QStringLiteral("lastLatency"), statistics.lastLatency / 1000.0);
+    result.insert(QStringLiteral("maxLatency"), statistics.maxLatency / 1000.0);
+    result.insert(QStringLiteral("meanLatency"), 0 < latencyCount ? statistics.totalLatency / 1000.0 / latencyCount : 0.0);
+    result.insert(QStringLiteral("latencyHistogram"), histogram);
+    result.insert(QStringLiteral("latencyBounds"), bounds);
+    return result;
+}
+
+void GPhotoViewfinderSettingsControl::resetPreviewStatistics()
+{
+    m_session->resetPreviewStatistics();
+}
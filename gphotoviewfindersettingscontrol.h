@@ -0,0 +1,71 @@
+#ifndef GPHOTOVIEWFINDERSETTINGSCONTROL_H
+#define GPHOTOVIEWFINDERSETTINGSCONTROL_H
+
+#include <QCameraViewfinderSettingsControl2>
+#include <QRectF>
+#include <QVariantMap>
+
+class GPhotoCameraSession;
+
+/** Viewfinder settings.
+ *
+ * Only resolution and frame rate cap of the standard settings may be set.
+ * Resolution is the size viewfinder shows, live view is decoded at the
+ * smallest JPEG scale which still covers it. "crop" property
+ * is a region of interest relative to frame size, viewfinder then shows
+ * only this region, which is decoded in more detail and for less CPU than
+ * the whole frame. Empty region shows the whole frame.
+ *
+ * "focusPeakingThreshold" property turns focus peaking on when it's above
+ * zero, every frame then carries a mask of edges with Laplacian magnitude
+ * over the threshold in "focusPeaking" meta data, see GPhotoFocusMeasure.
+ *
+ * startFrameExport() publishes live view to a shared memory ring of the
+ * given name for other processes, see GPhotoFrameExporter, "frameExport"
+ * property holds the name of the ring while it's exported.
+ *
+ * "previewStatistics" property holds live view delivery counters, see
+ * GPhotoCameraSession::PreviewStatistics, it's updated once a second while
+ * frames are delivered. Latencies are in milliseconds.
+ */
+class GPhotoViewfinderSettingsControl final : public QCameraViewfinderSettingsControl2
+{
+    Q_OBJECT
+    Q_PROPERTY(QRectF crop READ crop WRITE setCrop)
+    Q_PROPERTY(int focusPeakingThreshold READ focusPeakingThreshold WRITE setFocusPeakingThreshold)
+    Q_PROPERTY(QString frameExport READ frameExport)
+    Q_PROPERTY(QVariantMap previewStatistics READ previewStatistics NOTIFY previewStatisticsChanged)
+public:
+    explicit GPhotoViewfinderSettingsControl(GPhotoCameraSession *session, QObject *parent = nullptr);
+    ~GPhotoViewfinderSettingsControl() = default;
+
+    GPhotoViewfinderSettingsControl(GPhotoViewfinderSettingsControl&&) = delete;
+    GPhotoViewfinderSettingsControl& operator=(GPhotoViewfinderSettingsControl&&) = delete;
+
+    QList<QCameraViewfinderSettings> supportedViewfinderSettings() const final;
+    QCameraViewfinderSettings viewfinderSettings() const final;
+    void setViewfinderSettings(const QCameraViewfinderSettings &settings) final;
+
+    QRectF crop() const;
+    void setCrop(const QRectF &region);
+
+    int focusPeakingThreshold() const;
+    void setFocusPeakingThreshold(int threshold);
+
+    QString frameExport() const;
+    Q_INVOKABLE bool startFrameExport(const QString &name, int slotCount, int slotSize);
+    Q_INVOKABLE void stopFrameExport();
+
+    QVariantMap previewStatistics() const;
+    Q_INVOKABLE void resetPreviewStatistics();
+
+signals:
+    void previewStatisticsChanged();
+
+private:
+    Q_DISABLE_COPY(GPhotoViewfinderSettingsControl)
+
+    GPhotoCameraSession *const m_session;
+};
+
+#endif // GPHOTOVIEWFINDERSETTINGSCONTROL_H
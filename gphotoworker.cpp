@@ -127,6 +127,16 @@ bool GPhotoWorker::setParameter(int cameraIndex, const QString &name, const QVar
            ? m_cameras.at(path)->setParameter(name, value) : false;
 }
 
+QVariantMap GPhotoWorker::setParameters(int cameraIndex, const QVariantMap &values)
+{
+    if (!isCameraIndexValid(cameraIndex))
+      return {};
+
+    const auto &path = m_paths.at(cameraIndex);
+    return (!path.isEmpty() && m_cameras.cend() != m_cameras.find(path))
+           ? m_cameras.at(path)->setParameters(values) : QVariantMap();
+}
+
 QVariantList GPhotoWorker::parameterValues(int cameraIndex, const QString &name, QMetaType::Type valueType) const
 {
     if (!isCameraIndexValid(cameraIndex))
@@ -137,6 +147,107 @@ QVariantList GPhotoWorker::parameterValues(int cameraIndex, const QString &name,
            ? m_cameras.at(path)->parameterValues(name, valueType) : QVariantList();
 }
 
+void GPhotoWorker::refreshConfig(int cameraIndex)
+{
+    if (!isCameraIndexValid(cameraIndex))
+        return;
+
+    const auto &path = m_paths.at(cameraIndex);
+    if (!path.isEmpty() && m_cameras.cend() != m_cameras.find(path))
+        m_cameras.at(path)->refreshConfig();
+}
+
+void GPhotoWorker::setOperationTimeout(int cameraIndex, int timeout)
+{
+    if (!isCameraIndexValid(cameraIndex))
+        return;
+
+    const auto &path = m_paths.at(cameraIndex);
+    if (!path.isEmpty() && m_cameras.cend() != m_cameras.find(path))
+        m_cameras.at(path)->setOperationTimeout(timeout);
+}
+
+void GPhotoWorker::setPreviewSize(int cameraIndex, const QSize &size)
+{
+    if (!isCameraIndexValid(cameraIndex))
+        return;
+
+    const auto &path = m_paths.at(cameraIndex);
+    if (!path.isEmpty() && m_cameras.cend() != m_cameras.find(path))
+        m_cameras.at(path)->setPreviewSize(size);
+}
+
+void GPhotoWorker::setPreviewFormat(int cameraIndex, QVideoFrame::PixelFormat format)
+{
+    if (!isCameraIndexValid(cameraIndex))
+        return;
+
+    const auto &path = m_paths.at(cameraIndex);
+    if (!path.isEmpty() && m_cameras.cend() != m_cameras.find(path))
+        m_cameras.at(path)->setPreviewFormat(format);
+}
+
+void GPhotoWorker::setPreviewCrop(int cameraIndex, const QRectF &region)
+{
+    if (!isCameraIndexValid(cameraIndex))
+        return;
+
+    const auto &path = m_paths.at(cameraIndex);
+    if (!path.isEmpty() && m_cameras.cend() != m_cameras.find(path))
+        m_cameras.at(path)->setPreviewCrop(region);
+}
+
+void GPhotoWorker::setPreviewFrameRate(int cameraIndex, qreal frameRate)
+{
+    if (!isCameraIndexValid(cameraIndex))
+        return;
+
+    const auto &path = m_paths.at(cameraIndex);
+    if (!path.isEmpty() && m_cameras.cend() != m_cameras.find(path))
+        m_cameras.at(path)->setPreviewFrameRate(frameRate);
+}
+
+void GPhotoWorker::setPreviewStatisticsEnabled(int cameraIndex, bool enabled)
+{
+    if (!isCameraIndexValid(cameraIndex))
+        return;
+
+    const auto &path = m_paths.at(cameraIndex);
+    if (!path.isEmpty() && m_cameras.cend() != m_cameras.find(path))
+        m_cameras.at(path)->setPreviewStatisticsEnabled(enabled);
+}
+
+void GPhotoWorker::setPreviewFocusMeasurement(int cameraIndex, const QRectF &region, int peakingThreshold)
+{
+    if (!isCameraIndexValid(cameraIndex))
+        return;
+
+    const auto &path = m_paths.at(cameraIndex);
+    if (!path.isEmpty() && m_cameras.cend() != m_cameras.find(path))
+        m_cameras.at(path)->setPreviewFocusMeasurement(region, peakingThreshold);
+}
+
+void GPhotoWorker::setPreviewMotionDetection(int cameraIndex, const QVector<QRectF> &regions,
+                                             int threshold, int cooldown)
+{
+    if (!isCameraIndexValid(cameraIndex))
+        return;
+
+    const auto &path = m_paths.at(cameraIndex);
+    if (!path.isEmpty() && m_cameras.cend() != m_cameras.find(path))
+        m_cameras.at(path)->setPreviewMotionDetection(regions, threshold, cooldown);
+}
+
+void GPhotoWorker::previewConsumed(int cameraIndex, int count)
+{
+    if (!isCameraIndexValid(cameraIndex))
+        return;
+
+    const auto &path = m_paths.at(cameraIndex);
+    if (!path.isEmpty() && m_cameras.cend() != m_cameras.find(path))
+        m_cameras.at(path)->previewConsumed(count);
+}
+
 CameraAbilities GPhotoWorker::getCameraAbilities(int cameraIndex, bool *ok)
 {
     CameraAbilities abilities;
@@ -312,7 +423,10 @@ void GPhotoWorker::setupCamera(const QByteArray &path)
     connect(camera, &Camera::error, this, &Worker::error);
     connect(camera, &Camera::imageCaptureError, this, &Worker::imageCaptureError);
     connect(camera, &Camera::imageCaptured, this, &Worker::imageCaptured);
-    connect(camera, &Camera::previewCaptured, this, &Worker::previewCaptured);
+    connect(camera, &Camera::motionCaptureTriggered, this, &Worker::motionCaptureTriggered);
+    connect(camera, &Camera::parametersChanged, this, &Worker::parametersChanged);
+    // Frames are emitted from the decode thread, queueing them to this thread would wait for camera I/O
+    connect(camera, &Camera::previewCaptured, this, &Worker::previewCaptured, Qt::DirectConnection);
     connect(camera, &Camera::readyForCaptureChanged, this, &Worker::readyForCaptureChanged);
     connect(camera, &Camera::stateChanged, this, &Worker::stateChanged);
     connect(camera, &Camera::statusChanged, this, &Worker::statusChanged);
@@ -7,6 +7,9 @@
 #include <QElapsedTimer>
 #include <QMutex>
 #include <QObject>
+#include <QRectF>
+#include <QVector>
+#include <QVideoFrame>
 
 #include <gphoto2/gphoto2-abilities-list.h>
 #include <gphoto2/gphoto2-context.h>
@@ -38,7 +41,19 @@ public:
     Q_INVOKABLE void capturePhoto(int cameraIndex, int id, const QString &fileName);
     Q_INVOKABLE QVariant parameter(int cameraIndex, const QString &name);
     Q_INVOKABLE bool setParameter(int cameraIndex, const QString &name, const QVariant &value);
+    Q_INVOKABLE QVariantMap setParameters(int cameraIndex, const QVariantMap &values);
     Q_INVOKABLE QVariantList parameterValues(int cameraIndex, const QString &name, QMetaType::Type valueType) const;
+    Q_INVOKABLE void refreshConfig(int cameraIndex);
+    Q_INVOKABLE void setOperationTimeout(int cameraIndex, int timeout);
+    Q_INVOKABLE void setPreviewSize(int cameraIndex, const QSize &size);
+    Q_INVOKABLE void setPreviewFormat(int cameraIndex, QVideoFrame::PixelFormat format);
+    Q_INVOKABLE void setPreviewCrop(int cameraIndex, const QRectF &region);
+    Q_INVOKABLE void setPreviewFrameRate(int cameraIndex, qreal frameRate);
+    Q_INVOKABLE void setPreviewStatisticsEnabled(int cameraIndex, bool enabled);
+    Q_INVOKABLE void setPreviewFocusMeasurement(int cameraIndex, const QRectF &region, int peakingThreshold);
+    Q_INVOKABLE void setPreviewMotionDetection(int cameraIndex, const QVector<QRectF> &regions,
+                                               int threshold, int cooldown);
+    Q_INVOKABLE void previewConsumed(int cameraIndex, int count);
 
 signals:
     void captureModeChanged(int cameraIndex, QCamera::CaptureModes);
@@ -46,7 +61,9 @@ signals:
     void imageCaptureError(int cameraIndex, int id, int errorCode, const QString &errorString);
     void imageCaptured(int cameraIndex, int id, const QByteArray &imageData,
                        const QString &format, const QString &fileName);
-    void previewCaptured(int cameraIndex, const QImage &image);
+    void motionCaptureTriggered(int cameraIndex, int id, qint64 timestamp);
+    void parametersChanged(int cameraIndex, const QStringList &names);
+    void previewCaptured(int cameraIndex, const QVideoFrame &frame);
     void readyForCaptureChanged(int cameraIndex, bool readyForCapture);
     void stateChanged(int cameraIndex, QCamera::State state);
     void statusChanged(int cameraIndex, QCamera::Status status);